@@ -8,12 +8,47 @@
 #include <chrono>
 #include <ctime>
 #include <cctype>
+#include <deque>
+#include <queue>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <shared_mutex>
+#include <fstream>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <set>
+#include <cstdlib>
+#include <array>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <string_view>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
 
 using namespace std;
 // ------------------------------------------------------------
 // Smart Event Manager (CLI) — Online-Compiler-Friendly Version
 // ------------------------------------------------------------
-// Goal: Runs on restricted online IDEs (no file I/O, no external libs).
+// Goal: one source file, no external libs. Files are touched only when a
+// feature needs them (spill files, EVENT_OPLOG, the reminder outbox once a
+// reminder is queued), so the menu still runs on restricted online IDEs.
 // What it includes:
 // - OOP design (Event + EventManager)
 // - Add / Edit / Delete / View / Search
@@ -21,8 +56,56 @@ using namespace std;
 // - Date & time validation (DD-MM-YYYY / HH:MM 24h) — no <regex>
 // - Conflict detection (1-hour events) + suggested available slots
 // - Day view + Today's events (from system clock)
+// - Listings as table, CSV, TSV or JSON (menu option / server format= prefix)
+// - Week and month calendar grids: per-day counts plus the first events of each day
 // - Admin role gating (add/edit/delete/send/statistics)
-// - "Event Reminders": paste attendee emails (simulated sending)
+// - "Event Reminders": paste attendee emails (single-pass validator: quotes,
+//   "Name <addr>", mixed separators, rejections counted by reason); delivery
+//   runs on a background worker pool (SMTP relay via EVENT_SMTP_RELAY=host:port, else simulated;
+//   pooled pipelined sessions, multi-RCPT sends, EVENT_SMTP_ROUTES per domain)
+// - Reminder outbox: sends journaled per recipient (EVENT_OUTBOX), transient
+//   failures retried with exponential backoff, unfinished sends resumed on
+//   restart without repeating delivered recipients
+// - Delivery rate limits: global and per-domain token buckets
+//   (EVENT_RATE_LIMITS), jobs scheduled from a ready-time heap, domain rates
+//   backed off on 4xx replies and recovered gradually
+// - Automatic reminders 24h / 1h before each event (timer-wheel scheduler)
+// - Per-event registrations + digest reminders (one message per recipient
+//   per window; identical digests share one multi-recipient send)
+// - Reminder templates ({{placeholders}}, compiled once, rendered into reused
+//   buffers; personalized templates render per recipient on the workers)
+// - Replication: mutation log shipped over a socketpair to follower
+//   processes (hot standby that keeps the calendar if the CLI dies,
+//   bounded-staleness read replica serving viewer reads)
+// - Per-day index + push subscriptions (date / range / location watches)
+// - Benchmarks (--bench [MIN-MAX] [--counters]): core operations at
+//   10^MIN..10^MAX events, throughput, latency percentiles, allocations
+//   (-DEVENT_BENCH_ALLOCS builds) and (Linux perf_event_open) cycles,
+//   instructions, cache and branch misses per call
+// - Benchmark baselines (--bench ... --reps N --save/--compare FILE
+//   --threshold PCT): JSON results, 95% confidence intervals and a Welch
+//   t-test per operation; exits 1 on a significant regression
+// - Workload generator (--generate): seeded catalogues with conference bursts,
+//   recurring series, weekday/hour skew and Zipf popularity, written as CSV,
+//   snapshot (with attendees) or a mixed read/write server trace
+// - Per-operation latency histograms (per-thread HDR-style buckets, merged on
+//   read): admin menu option and server LATENCY, p50/p99/p999 and counts
+// - Trace spans (build with -DEVENT_TRACING): per-thread rings of phase
+//   timings, dumped as Chrome trace JSON (admin menu option / server TRACE)
+// - Server mode (--serve): line protocol on stdin with per-class admission
+//   queues, deadlines and backpressure
+// - Prometheus metrics (server METRICS, --metrics-port N for GET /metrics on
+//   loopback): request and lane counters, operation latency histograms, store,
+//   index, WAL and reminder gauges, rendered from atomics without the store lock
+// - Operation log (EVENT_OPLOG=FILE): CLI actions and server requests as
+//   timestamped protocol lines; --replay FILE re-runs them through the server
+//   dispatcher at the original pace or --fast, from one or many client threads
+// - Cluster (--cluster N): events hash-partitioned on (tenant, day) across N
+//   worker processes; day-scoped commands go to the owning worker, LIST and
+//   SEARCH scatter-gather with a k-way merge, ADDWORKER rebalances
+// - Multi-tenant host: one calendar per organization, memory quotas and
+//   LRU eviction of idle calendars to spill files; memory reported per
+//   subsystem (event strings, index, log, attendees, timers, ...)
 //
 // NOTE: Persistent storage and .xlsx reading are NOT possible in most
 // online IDEs. As a workaround, we provide:
@@ -39,6 +122,39 @@ struct Event {
     string location;          // optional
 };
 
+// One entry of the leader's mutation log. Put carries the full row (insert or
+// overwrite by id); Erase only needs e.id.
+struct Mutation {
+    enum Op { Put, Erase } op = Put;
+    long long lsn = 0;
+    Event e;
+};
+
+// Incremental notification delivered to subscribers. Updated means the event
+// was in scope before and after the change; an edit that moves an event out
+// of (or into) a watched scope arrives as Removed (or Added).
+struct ChangeNote {
+    enum Kind { Added, Updated, Removed } kind;
+    Event e;
+    int subId;
+};
+
+struct Subscription {
+    int id;
+    int fromDay, toDay;       // dayKey range, inclusive
+    string location;          // empty = any
+    function<void(const ChangeNote&)> sink;
+};
+
+// Approximate heap footprint of a string (libstdc++ keeps <=15 chars inline).
+static size_t heapBytes(const string& s){ return s.capacity()>15 ? s.capacity()+1 : 0; }
+static size_t eventBytes(const Event& e){ return sizeof(Event)+heapBytes(e.name)+heapBytes(e.date)+heapBytes(e.time)+heapBytes(e.type)+heapBytes(e.location); }
+
+// Everything below prints through out(). Server workers point it at a
+// per-request buffer so concurrent responses don't interleave.
+static thread_local ostream* tlsOut = nullptr;
+static ostream& out(){ return tlsOut ? *tlsOut : cout; }
+
 static string toLower(string s)
 { 
     for(char& c:s) 
@@ -46,270 +162,4256 @@ static string toLower(string s)
     return s;
 }
 
-static bool iequals(const string& a, const string& b){
-    return toLower(a)==toLower(b);
-}
+static bool iequals(const string& a, const string& b){
+    return toLower(a)==toLower(b);
+}
+
+static bool icontains(const string& text, const string& key){
+    string t=toLower(text), k=toLower(key);
+    return t.find(k)!=string::npos;
+}
+
+// Stable across runs and builds (unlike std::hash): cluster placement, outbox keys.
+static uint64_t fnv1a(const string& s){ uint64_t h=1469598103934665603ULL; for (unsigned char c: s){ h^=c; h*=1099511628211ULL; } return h; }
+
+// Line-oriented records (mutation log, spill files, reminder outbox): fields
+// are tab separated with \\ \t \n escaped.
+static string escapeField(const string& s){ string r; for(char c: s){ if(c=='\\') r+="\\\\"; else if(c=='\t') r+="\\t"; else if(c=='\n') r+="\\n"; else r+=c; } return r; }
+
+static vector<string> splitEscaped(const string& line){
+    vector<string> f(1);
+    for (size_t i=0;i<line.size();i++){
+        char c=line[i];
+        if (c=='\t'){ f.emplace_back(); continue; }
+        if (c=='\\' && i+1<line.size()){ c=line[++i]; if(c=='t') c='\t'; else if(c=='n') c='\n'; }
+        f.back()+=c;
+    }
+    return f;
+}
+
+// Protocol rows: name|date|time|type|location. Inside a field "\|" is a
+// literal '|' and "\\" a backslash; any other backslash is kept as is.
+static string escapeRowField(const string& s){ string r; for (char c: s){ if (c=='|' || c=='\\') r+='\\'; r+=c; } return r; }
+
+static vector<string> splitFields(const string& s){
+    vector<string> f(1);
+    for (size_t i=0;i<s.size();i++){
+        if (s[i]=='\\' && i+1<s.size() && (s[i+1]=='|' || s[i+1]=='\\')) f.back()+=s[++i];
+        else if (s[i]=='|') f.emplace_back();
+        else f.back()+=s[i];
+    }
+    return f;
+}
+
+// ------------------- Attendee email parsing -------------------
+// Single-pass tokenizer for pasted address lists. Entries are separated by
+// ',' ';' or line ends (outside quotes and angle brackets) and are a bare
+// address, several whitespace-separated ones, or "Display Name <addr>"
+// (anything after the '>' up to the next separator is ignored).
+// Addresses are checked against a practical subset of RFC 5322 addr-spec:
+// a dot-atom or quoted local part (<= 64), '@', and a dotted domain of LDH
+// labels (<= 63 each, <= 253 total) or an [address literal]. scan() reports
+// views into its input and never allocates; entries don't span calls, so a
+// caller can feed one line at a time.
+class EmailScanner {
+public:
+    enum Reason { NoAddress, MissingAt, MultipleAt, BadLocalPart, LocalTooLong, BadDomain, NoDomainDot, DomainTooLong, Unterminated, kReasons };
+
+    array<size_t,kReasons> rejected{};
+    size_t accepted = 0;
+
+    static const char* reasonName(int r){
+        static const char* names[kReasons] = {"no address","missing '@'","more than one '@'","bad local part","local part too long",
+                                              "bad domain","domain without '.'","domain too long","unterminated quote or '<'"};
+        return names[r];
+    }
+
+    size_t rejectedTotal() const { size_t n=0; for (size_t r: rejected) n+=r; return n; }
+
+    // Calls emit(string_view) for every valid address in text.
+    template<class Emit> void scan(string_view text, Emit&& emit){
+        const auto& cls = classes();
+        size_t i=0, n=text.size();
+        while (i<n){
+            while (i<n && (cls[(unsigned char)text[i]]&(Space|Sep))) i++;
+            if (i>=n) break;
+            size_t start=i, lt=string_view::npos, gt=string_view::npos; bool quoted=false;
+            for (; i<n; i++){
+                if (!quoted) while (i<n && !(cls[(unsigned char)text[i]]&Special)) i++;   // bulk of the bytes
+                if (i>=n) break;
+                char c=text[i];
+                if (quoted){ if (c=='\\' && i+1<n) i++; else if (c=='"') quoted=false; continue; }
+                if (c=='"') quoted=true;
+                else if (c=='<' && lt==string_view::npos) lt=i;
+                else if (c=='>' && lt!=string_view::npos){ gt=i++; break; }
+                else if ((cls[(unsigned char)c]&Sep) && lt==string_view::npos) break;
+            }
+            if (quoted || (lt!=string_view::npos && gt==string_view::npos)){ rejected[Unterminated]++; continue; }
+            if (lt!=string_view::npos){
+                check(trim(text.substr(lt+1,gt-lt-1)),emit);
+                // Whatever follows '>' in the entry ("(work)", a stray word) is not an entry of its own.
+                for (bool q=false; i<n && (q || !(cls[(unsigned char)text[i]]&Sep)); i++){
+                    if (q && text[i]=='\\' && i+1<n) i++; else if (text[i]=='"') q=!q;
+                }
+                continue;
+            }
+
+            // Bare entry: every word with an '@' is an address; the others
+            // are a display name unless the entry has no address at all.
+            string_view entry=text.substr(start,i-start); bool any=false;
+            for (size_t j=0; j<entry.size(); ){
+                while (j<entry.size() && (cls[(unsigned char)entry[j]]&Space)) j++;
+                size_t w=j; bool q=false, at=false;
+                for (; j<entry.size() && (q || !(cls[(unsigned char)entry[j]]&Space)); j++){
+                    if (!q) while (j<entry.size() && !(cls[(unsigned char)entry[j]]&WordStop)) j++;
+                    if (j>=entry.size() || (!q && (cls[(unsigned char)entry[j]]&Space))) break;
+                    if (q){ if (entry[j]=='\\' && j+1<entry.size()) j++; else if (entry[j]=='"') q=false; }
+                    else if (entry[j]=='"') q=true;
+                    else if (entry[j]=='@') at=true;
+                }
+                if (at){ any=true; check(entry.substr(w,j-w),emit); }
+            }
+            if (!any) rejected[NoAddress]++;
+        }
+    }
+
+private:
+    enum : uint8_t { Atext=1, Ldh=2, Space=4, Sep=8, Special=16, WordStop=32 };
+
+    static const array<uint8_t,256>& classes(){
+        static const array<uint8_t,256> t = []{
+            array<uint8_t,256> c{};
+            for (int ch=0; ch<256; ch++){
+                if (isalnum(ch)) c[ch] |= Atext|Ldh;
+                if (ch && strchr("!#$%&'*+-/=?^_`{|}~",ch)) c[ch] |= Atext;
+            }
+            c['-'] |= Ldh;
+            c[' ']=c['\t']=c['\r']=Space|WordStop;
+            c[',']=c[';']=c['\n']=Sep|Special;
+            c['"'] |= Special|WordStop; c['<'] |= Special; c['>'] |= Special; c['@'] |= WordStop;
+            return c;
+        }();
+        return t;
+    }
+
+    static string_view trim(string_view s){
+        while (!s.empty() && (s.front()==' '||s.front()=='\t')) s.remove_prefix(1);
+        while (!s.empty() && (s.back()==' '||s.back()=='\t'||s.back()=='\r')) s.remove_suffix(1);
+        return s;
+    }
+
+    template<class Emit> void check(string_view a, Emit& emit){
+        int why = validate(a);
+        if (why<0){ accepted++; emit(a); } else rejected[why]++;
+    }
+
+    // Returns -1 for a valid addr-spec, else the Reason.
+    static int validate(string_view a){
+        const auto& cls = classes();
+        if (a.empty()) return NoAddress;
+        size_t p=0;
+        if (a[0]=='"'){
+            for (p=1; p<a.size() && a[p]!='"'; p++){
+                if ((unsigned char)a[p]<0x20) return BadLocalPart;
+                if (a[p]=='\\') p++;
+            }
+            if (p>=a.size()) return Unterminated;
+            p++;
+        } else {
+            for (; p<a.size() && a[p]!='@'; p++){
+                if (a[p]=='.'){ if (p==0 || a[p-1]=='.' || p+1==a.size() || a[p+1]=='@') return BadLocalPart; }
+                else if (!(cls[(unsigned char)a[p]]&Atext)) return BadLocalPart;
+            }
+            if (p==0 && p<a.size()) return BadLocalPart;
+        }
+        if (p>=a.size()) return MissingAt;
+        if (a[p]!='@') return BadLocalPart;
+        if (p>64) return LocalTooLong;
+        string_view d=a.substr(p+1);
+        if (d.find('@')!=string_view::npos) return MultipleAt;
+        if (d.empty()) return BadDomain;
+        if (d.size()>253) return DomainTooLong;
+        if (d.front()=='['){
+            if (d.size()<3 || d.back()!=']') return BadDomain;
+            for (char c: d.substr(1,d.size()-2)) if (!isxdigit((unsigned char)c) && c!='.' && c!=':') return BadDomain;
+            return -1;
+        }
+        size_t label=0, dots=0;
+        for (size_t k=0; k<=d.size(); k++){
+            if (k==d.size() || d[k]=='.'){
+                if (label==0 || label>63 || d[k-label]=='-' || d[k-1]=='-') return BadDomain;
+                if (k<d.size()) dots++;
+                label=0;
+            } else if (!(cls[(unsigned char)d[k]]&Ldh)) return BadDomain;
+            else label++;
+        }
+        return dots ? -1 : NoDomainDot;
+    }
+};
+
+// ------------------- Reminder delivery -------------------
+// Transport for rendered reminders. deliver() sends one message to a batch of
+// recipients and reports every recipient's outcome through report() as soon
+// as its transaction completes.
+class MailTransport {
+public:
+    // Transient: 4xx replies and recipients left unanswered by a broken or
+    // unreachable server; the pipeline retries those. Permanent: 5xx.
+    enum Outcome : char { Accepted, Transient, Permanent };
+    using Report = function<void(size_t index, Outcome outcome, const string& reason)>;
+    using Render = function<void(const string& rcpt, string& subject, string& body)>;
+
+    virtual ~MailTransport() = default;
+    virtual void deliver(const string& subject, const string& body, const vector<string>& rcpts, const Report& report) = 0;
+    virtual string describe() const = 0;
+
+    // Personalized variant: render() fills reused buffers for each recipient.
+    virtual void deliverEach(const vector<string>& rcpts, const Render& render, const Report& report){
+        string subject, body; vector<string> one(1);
+        for (size_t i=0;i<rcpts.size();i++){
+            subject.clear(); body.clear(); render(rcpts[i],subject,body); one[0]=rcpts[i];
+            deliver(subject,body,one,[&](size_t, Outcome o, const string& why){ report(i,o,why); });
+        }
+    }
+};
+
+// Default when no relay is configured: accepts everything, sends nothing.
+class SimulatedTransport : public MailTransport {
+public:
+    void deliver(const string&, const string&, const vector<string>& rcpts, const Report& report) override { for (size_t i=0;i<rcpts.size();i++) report(i,Accepted,""); }
+    string describe() const override { return "simulated (no relay configured)"; }
+};
+
+#ifndef _WIN32
+// SMTP client with persistent, pipelined sessions. Recipients are routed by
+// domain (per-domain routes, else the relay); idle sessions are pooled per
+// destination host and reused across batches. Shared content goes out as
+// one transaction with up to kMaxRcpt RCPT TOs; when the server advertises
+// PIPELINING, MAIL/RCPT/DATA are written in one round trip.
+class SmtpTransport : public MailTransport {
+public:
+    struct Route { string host; int port; string key() const { return host+":"+to_string(port); } };
+
+private:
+    static const size_t kMaxRcpt = 100;
+    string from;
+    Route relay;
+    map<string,Route> routes;            // lower-case domain -> route
+
+    struct Session {
+        int fd = -1; string rbuf; bool pipelining = false;
+        ~Session(){ if (fd>=0) close(fd); }
+
+        bool sendAll(const string& s){
+            for (size_t off=0; off<s.size(); ){ ssize_t n=::send(fd,s.data()+off,s.size()-off,MSG_NOSIGNAL); if (n<=0) return false; off+=(size_t)n; }
+            return true;
+        }
+
+        // Reads one (possibly multi-line) reply and returns its code, 0 on I/O error.
+        int reply(string& text){
+            text.clear();
+            while (true){
+                size_t nl;
+                while ((nl=rbuf.find('\n'))==string::npos){
+                    char buf[4096]; ssize_t n=recv(fd,buf,sizeof buf,0);
+                    if (n<=0) return 0;
+                    rbuf.append(buf,(size_t)n);
+                }
+                string line=rbuf.substr(0,nl); rbuf.erase(0,nl+1);
+                if (!line.empty() && line.back()=='\r') line.pop_back();
+                text += line + "\n";
+                if (line.size()<4 || line[3]!='-') return line.size()>=3 && isdigit((unsigned char)line[0]) ? stoi(line.substr(0,3)) : 0;
+            }
+        }
+
+        int command(const string& cmd, string& text){ return sendAll(cmd+"\r\n") ? reply(text) : 0; }
+    };
+
+    mutex poolMu;
+    unordered_map<string,vector<unique_ptr<Session>>> idle;
+    atomic<uint64_t> opened{0}, transactions{0};
+
+    const Route& routeFor(const string& rcpt) const {
+        size_t at=rcpt.rfind('@');
+        if (at!=string::npos && !routes.empty()){ auto it=routes.find(toLower(rcpt.substr(at+1))); if (it!=routes.end()) return it->second; }
+        return relay;
+    }
+
+    unique_ptr<Session> open(const Route& r, string& err){
+        auto s = make_unique<Session>();
+        addrinfo hints{}, *res=nullptr; hints.ai_socktype=SOCK_STREAM;
+        if (getaddrinfo(r.host.c_str(),to_string(r.port).c_str(),&hints,&res)!=0 || !res){ err="cannot resolve "+r.host; return nullptr; }
+        for (addrinfo* a=res; a && s->fd<0; a=a->ai_next){
+            s->fd=socket(a->ai_family,a->ai_socktype,a->ai_protocol);
+            if (s->fd>=0 && connect(s->fd,a->ai_addr,a->ai_addrlen)!=0){ close(s->fd); s->fd=-1; }
+        }
+        freeaddrinfo(res);
+        if (s->fd<0){ err="cannot connect to "+r.key(); return nullptr; }
+        string text;
+        if (s->reply(text)!=220 || s->command("EHLO event-manager",text)!=250){ err="handshake failed: "+text; return nullptr; }
+        s->pipelining = toLower(text).find("pipelining")!=string::npos;
+        opened++;
+        return s;
+    }
+
+    unique_ptr<Session> checkout(const Route& r, bool& reused, string& err){
+        {
+            lock_guard<mutex> lk(poolMu);
+            auto& v = idle[r.key()];
+            if (!v.empty()){ auto s=move(v.back()); v.pop_back(); reused=true; return s; }
+        }
+        reused=false; return open(r,err);
+    }
+
+    void checkin(const Route& r, unique_ptr<Session> s){ lock_guard<mutex> lk(poolMu); idle[r.key()].push_back(move(s)); }
+
+    // CRLF line endings and dot-stuffing for the DATA section.
+    static string dataSection(const string& to, const string& from, const string& subject, const string& body){
+        string d = "From: "+from+"\r\nTo: "+to+"\r\nSubject: "+subject+"\r\n\r\n";
+        size_t start=0;
+        while (start<body.size()){
+            size_t nl=body.find('\n',start); if (nl==string::npos) nl=body.size();
+            if (body[start]=='.') d+='.';
+            d.append(body,start,nl-start); d+="\r\n"; start=nl+1;
+        }
+        return d+".\r\n";
+    }
+
+    static Outcome outcomeOf(int code){ return code/100==2 ? Accepted : code/100==4 ? Transient : Permanent; }
+
+    // One transaction to rcpts[idx[0..n)); every recipient is reported once
+    // the server has answered DATA (or the transaction was abandoned).
+    // Returns false if the session broke (I/O error): nothing of this
+    // transaction was reported and the session must not be reused.
+    bool transaction(Session& s, const vector<string>& rcpts, const size_t* idx, size_t n, const string& subject, const string& body, const Report& report){
+        string text, mail="MAIL FROM:<"+from+">";
+        vector<int> codes(n,0); vector<string> why(n); int mailCode, dataCode;
+        if (s.pipelining){
+            string batch=mail+"\r\n"; for (size_t i=0;i<n;i++) batch+="RCPT TO:<"+rcpts[idx[i]]+">\r\n"; batch+="DATA\r\n";
+            if (!s.sendAll(batch) || !(mailCode=s.reply(text))) return false;
+            string mailText=text;
+            for (size_t i=0;i<n;i++){ if (!(codes[i]=s.reply(why[i]))) return false; if (mailCode!=250){ codes[i]=mailCode; why[i]="MAIL FROM: "+mailText; } }
+            if (!(dataCode=s.reply(text))) return false;
+        } else {
+            if (!(mailCode=s.command(mail,text))) return false;
+            for (size_t i=0;i<n;i++){
+                if (mailCode!=250){ codes[i]=mailCode; why[i]="MAIL FROM: "+text; continue; }
+                if (!(codes[i]=s.command("RCPT TO:<"+rcpts[idx[i]]+">",why[i]))) return false;
+            }
+            bool any = any_of(codes.begin(),codes.end(),[](int c){return c/100==2;});
+            dataCode = mailCode==250 && any ? s.command("DATA",text) : 503;
+            if (!dataCode) return false;
+        }
+        size_t accepted = count_if(codes.begin(),codes.end(),[](int c){return c/100==2;});
+        int finalCode=250; string finalText;
+        if (dataCode==354){
+            if (!s.sendAll(accepted ? dataSection(n==1?rcpts[idx[0]]:"undisclosed-recipients:;",from,subject,body) : ".\r\n")) return false;
+            if (!(finalCode=s.reply(text))) return false;
+            finalText="DATA: "+text;
+        } else {
+            finalCode=dataCode; finalText="DATA: "+text;
+            if (s.command("RSET",text)!=250) return false;
+        }
+        transactions++;
+        for (size_t i=0;i<n;i++){
+            bool rcptOk = codes[i]/100==2;
+            Outcome o = outcomeOf(rcptOk ? finalCode : codes[i]);
+            string& reason = rcptOk ? finalText : why[i];
+            while (!reason.empty() && reason.back()=='\n') reason.pop_back();
+            report(idx[i],o,o==Accepted ? string() : reason);
+        }
+        return true;
+    }
+
+    // Runs send(session) on a pooled session for route r. send() returns
+    // false when the session broke and must resume where it stopped; a
+    // reused (possibly timed-out) session gets one retry on a fresh one.
+    template<class Send> void withSession(const Route& r, string& err, Send send){
+        for (int attempt=0; attempt<2; attempt++){
+            bool reused=false;
+            auto s = checkout(r,reused,err); if (!s) return;
+            if (send(*s)){ checkin(r,move(s)); return; }
+            if (!reused){ if (err.empty()) err="connection to "+r.key()+" lost"; return; }
+        }
+    }
+
+    // Index recipients by route so each destination host gets one session.
+    map<string,pair<const Route*,vector<size_t>>> byRoute(const vector<string>& rcpts) const {
+        map<string,pair<const Route*,vector<size_t>>> groups;
+        for (size_t i=0;i<rcpts.size();i++){ const Route& r=routeFor(rcpts[i]); auto& g=groups[r.key()]; g.first=&r; g.second.push_back(i); }
+        return groups;
+    }
+
+public:
+    SmtpTransport(Route relayRoute, string sender, map<string,Route> domainRoutes = {}):
+        from(move(sender)), relay(move(relayRoute)), routes(move(domainRoutes)) {}
+
+    ~SmtpTransport() override {
+        string text;
+        for (auto& h: idle) for (auto& s: h.second) s->command("QUIT",text);
+    }
+
+    // Recipients a route could not finish (unreachable, connection lost)
+    // are reported Transient with the connection error.
+    void deliver(const string& subject, const string& body, const vector<string>& rcpts, const Report& report) override {
+        for (auto& g: byRoute(rcpts)){
+            const vector<size_t>& idx = g.second.second; size_t next=0; string err;
+            withSession(*g.second.first,err,[&](Session& s){
+                for (; next<idx.size(); next+=kMaxRcpt)
+                    if (!transaction(s,rcpts,&idx[next],min(kMaxRcpt,idx.size()-next),subject,body,report)) return false;
+                return true;
+            });
+            for (; next<idx.size(); next++) report(idx[next],Transient,err);
+        }
+    }
+
+    void deliverEach(const vector<string>& rcpts, const Render& render, const Report& report) override {
+        string subject, body;
+        for (auto& g: byRoute(rcpts)){
+            const vector<size_t>& idx = g.second.second; size_t next=0; string err;
+            withSession(*g.second.first,err,[&](Session& s){
+                for (; next<idx.size(); next++){
+                    subject.clear(); body.clear(); render(rcpts[idx[next]],subject,body);
+                    if (!transaction(s,rcpts,&idx[next],1,subject,body,report)) return false;
+                }
+                return true;
+            });
+            for (; next<idx.size(); next++) report(idx[next],Transient,err);
+        }
+    }
+
+    string describe() const override {
+        return "smtp://"+relay.key()+(routes.empty()?"":" (+"+to_string(routes.size())+" domain routes)")
+             +", sessions opened "+to_string(opened.load())+", transactions "+to_string(transactions.load());
+    }
+};
+#endif
+
+// Append-only journal of reminder groups and per-recipient outcomes. The
+// idempotency key of a delivery is (group key, recipient): whatever has a D
+// or X record is never sent again, so a restart resumes unfinished groups
+// without repeating completed recipients. One record per line:
+//   G <key> <label> <subject> <body> <recipe>   group (recipe: personalized)
+//   + <key> <rcpt>                              recipient to deliver
+//   D <key> <rcpt>                              delivered
+//   X <key> <rcpt> <reason>                     bounced or given up
+//   K <key>                                     group finished
+// Outcome records are flushed as they are written, so a crash repeats at
+// most the transactions in flight. The file is compacted when opened.
+class ReminderOutbox {
+public:
+    struct Unfinished { string key, label, subject, body, recipe; vector<string> rcpts; };
+
+private:
+    static const size_t kKeepFinished = 10000;   // keys remembered after compaction
+    string path;
+    ofstream os;
+    mutex mu;
+    atomic<bool> live{false};      // read by workers without mu; rewrite() reopens os
+
+    void append(const string& line){ lock_guard<mutex> lk(mu); os<<line<<'\n'<<flush; }
+
+public:
+    const string& file() const { return path; }
+    bool isOpen() const { return live; }
+
+    // Loads the journal, rewrites it with only what is still open and keeps
+    // appending to it. Finished group keys are returned in `finished`.
+    bool open(const string& file, vector<Unfinished>& pending, set<string>& finished){
+        path=file;
+        vector<Unfinished> groups; unordered_map<string,size_t> at;
+        unordered_map<string,unordered_set<string>> settled; vector<string> doneKeys;
+        ifstream is(path); string line;
+        while (getline(is,line)){
+            vector<string> f=splitEscaped(line);
+            if (f.size()<2 || f[0].size()!=1) continue;           // torn last line
+            char kind=f[0][0]; const string& key=f[1];
+            if (kind=='G' && f.size()==6 && !at.count(key)){ at[key]=groups.size(); groups.push_back({key,f[2],f[3],f[4],f[5],{}}); }
+            else if (kind=='+' && f.size()==3 && at.count(key)) groups[at[key]].rcpts.push_back(f[2]);
+            else if ((kind=='D' || kind=='X') && f.size()>=3) settled[key].insert(f[2]);
+            else if (kind=='K') doneKeys.push_back(key);
+        }
+        is.close();
+        for (auto& g: groups){
+            auto it=settled.find(g.key); vector<string> open;
+            for (auto& r: g.rcpts) if (it==settled.end() || !it->second.count(r)) open.push_back(move(r));
+            g.rcpts.swap(open);
+            if (g.rcpts.empty()) doneKeys.push_back(g.key); else pending.push_back(move(g));
+        }
+        finished.insert(doneKeys.begin(),doneKeys.end());
+        return rewrite(doneKeys,pending);
+    }
+
+    // Replaces the journal with K records for doneKeys (the last
+    // kKeepFinished of them) plus the open groups, then keeps appending.
+    bool rewrite(vector<string> doneKeys, const vector<Unfinished>& open){
+        if (doneKeys.size()>kKeepFinished) doneKeys.erase(doneKeys.begin(),doneKeys.end()-kKeepFinished);
+        lock_guard<mutex> lk(mu);
+        string tmp=path+".tmp";
+        {
+            ofstream w(tmp,ios::trunc);
+            for (const auto& k: doneKeys) w<<"K\t"<<escapeField(k)<<'\n';
+            for (const auto& g: open){
+                w<<"G\t"<<escapeField(g.key)<<'\t'<<escapeField(g.label)<<'\t'<<escapeField(g.subject)<<'\t'<<escapeField(g.body)<<'\t'<<escapeField(g.recipe)<<'\n';
+                for (const auto& r: g.rcpts) w<<"+\t"<<escapeField(g.key)<<'\t'<<escapeField(r)<<'\n';
+            }
+            if (!w.flush()) return false;
+        }
+        if (os.is_open()) os.close();
+        if (rename(tmp.c_str(),path.c_str())==0) os.open(path,ios::app);
+        live=os.is_open();
+        return live;
+    }
+
+    void group(const string& key, const string& label, const string& subject, const string& body, const string& recipe, const vector<string>& rcpts){
+        string k=escapeField(key), rec="G\t"+k+'\t'+escapeField(label)+'\t'+escapeField(subject)+'\t'+escapeField(body)+'\t'+escapeField(recipe);
+        lock_guard<mutex> lk(mu);
+        os<<rec<<'\n';
+        for (const auto& r: rcpts) os<<"+\t"<<k<<'\t'<<escapeField(r)<<'\n';
+        os<<flush;
+    }
+    void delivered(const string& key, const string& rcpt){ append("D\t"+escapeField(key)+'\t'+escapeField(rcpt)); }
+    void rejected(const string& key, const string& rcpt, const string& reason){ append("X\t"+escapeField(key)+'\t'+escapeField(rcpt)+'\t'+escapeField(reason)); }
+    void finished(const string& key){ append("K\t"+escapeField(key)); }
+};
+
+// Refills at `rate` tokens per second up to `burst`; rate 0 is unlimited.
+// Not synchronized: the owner serializes access.
+struct TokenBucket {
+    using Clock = chrono::steady_clock;
+    double rate, burst, tokens; Clock::time_point last = Clock::now();
+
+    TokenBucket(double perSecond=0, double size=0): rate(perSecond), burst(max(size,1.0)), tokens(burst) {}
+    bool unlimited() const { return rate<=0; }
+    void refill(Clock::time_point now){ if (!unlimited()) tokens=min(burst,tokens+rate*chrono::duration<double>(now-last).count()); last=now; }
+    size_t available() const { return unlimited() ? SIZE_MAX : (size_t)max(0.0,tokens); }
+    void take(size_t n){ if (!unlimited()) tokens-=(double)n; }
+    // How long until n tokens (n <= burst) will have accrued.
+    Clock::duration until(size_t n) const {
+        if (unlimited() || tokens>=(double)n) return Clock::duration::zero();
+        return chrono::duration_cast<Clock::duration>(chrono::duration<double>(((double)n-tokens)/rate));
+    }
+};
+
+// Renders once, splits recipients into batches and lets a worker pool deliver
+// them in the background. Every batch is a tracked job; jobs submitted
+// together form a group that report() summarizes. Recipients that failed
+// transiently go into a retry job after an exponential backoff (base, 2x,
+// 4x, ...); after kMaxAttempts they are given up. With an outbox attached,
+// groups and outcomes are journaled and unfinished groups resume on start.
+// Jobs wait in one heap ordered by ready time (new, retry backoff, or rate
+// limit), so workers sleep until the earliest one instead of polling. With
+// rate limits set, batches hold a single domain and are admitted only when
+// the global and the domain's token bucket can pay for them.
+class ReminderPipeline {
+public:
+    enum JobState { Queued, Sending, Sent, Deferred, Failed };   // Deferred: some recipients retried later
+    using Revive = function<MailTransport::Render(const string& recipe)>;
+
+private:
+    using Clock = chrono::steady_clock;
+    static const int kMaxAttempts = 6;
+
+    struct Message { string subject, body; };
+    struct Job {
+        int group; vector<string> rcpts; int attempt=0;
+        string domain;                                     // set when rate limited
+        JobState state=Queued; size_t delivered=0, bounced=0; string error{};
+    };
+    struct Ready {
+        Clock::time_point at; uint64_t seq; size_t job;
+        bool operator>(const Ready& o) const { return at!=o.at ? at>o.at : seq>o.seq; }
+    };
+    struct DomainLimit { TokenBucket bucket; double ceiling; };   // ceiling: configured rate
+    struct Group {
+        string key, label;
+        shared_ptr<const Message> msg;                     // shared content, or
+        shared_ptr<const MailTransport::Render> render;    // per-recipient rendering
+        size_t jobs=0, recipients=0, settled=0; bool resumed=false;
+    };
+
+    unique_ptr<MailTransport> transport;
+    size_t batchSize;
+    chrono::milliseconds retryBase;
+    mutable mutex mu; condition_variable cv;
+    deque<Job> jobs;                 // stable addresses; index = job id - 1
+    vector<Ready> ready;             // min-heap on (ready time, order queued)
+    uint64_t readySeq = 0;
+    vector<Group> groups;
+    unordered_map<string,int> groupByKey;
+    set<string> finishedKeys;        // completed before this run
+    ReminderOutbox outbox;
+    string lazyOutbox;               // opened by the first journaled submission
+    atomic<uint64_t> keySeq{0};
+    bool limited = false;
+    TokenBucket global;
+    pair<double,double> domainDefault{0,0};                // rate, burst for unlisted domains
+    map<string,pair<double,double>> domainConfig;
+    unordered_map<string,DomainLimit> domainLimits;        // created on first use
+    size_t throttled = 0;
+    vector<thread> workers;
+    bool stopping = false;
+
+    // Caller holds mu.
+    void push(size_t job, Clock::time_point at){
+        ready.push_back({at,readySeq++,job}); push_heap(ready.begin(),ready.end(),greater<Ready>());
+        cv.notify_one();
+    }
+    size_t pop(){ pop_heap(ready.begin(),ready.end(),greater<Ready>()); size_t j=ready.back().job; ready.pop_back(); return j; }
+
+    DomainLimit& limitFor(const string& domain){
+        auto it=domainLimits.find(domain);
+        if (it==domainLimits.end()){
+            auto c=domainConfig.find(domain); auto cfg = c==domainConfig.end() ? domainDefault : c->second;
+            it=domainLimits.emplace(domain,DomainLimit{TokenBucket(cfg.first,cfg.second),cfg.first}).first;
+        }
+        return it->second;
+    }
+
+    // Caller holds mu. Pays for as much of the job as both buckets allow
+    // (splitting off the rest as a new job), or returns false with `at` set
+    // to when a worthwhile chunk (half a burst) will have accrued.
+    bool admit(size_t idx, Clock::time_point now, Clock::time_point& at){
+        if (!limited) return true;
+        Job& job=jobs[idx]; TokenBucket& dom=limitFor(job.domain).bucket;
+        global.refill(now); dom.refill(now);
+        auto chunk=[](const TokenBucket& b){ return b.unlimited() ? SIZE_MAX : max<size_t>(1,(size_t)(b.burst/2)); };
+        size_t want=min({job.rcpts.size(),chunk(global),chunk(dom)});
+        size_t n=min({job.rcpts.size(),global.available(),dom.available()});
+        if (n<want){ at=now+max(global.until(want),dom.until(want)); throttled++; return false; }
+        global.take(n); dom.take(n);
+        if (n<job.rcpts.size()){
+            Job rest{job.group,vector<string>(job.rcpts.begin()+n,job.rcpts.end()),job.attempt,job.domain};
+            job.rcpts.resize(n);
+            jobs.push_back(move(rest)); groups[job.group-1].jobs++; push(jobs.size()-1,now);
+        }
+        return true;
+    }
+
+    // Caller holds mu. AIMD on a domain's rate: transient failures halve it
+    // (down to 1/16 of the configured rate), clean batches win back 1/10.
+    void adapt(const string& domain, bool backOff){
+        DomainLimit& d=limitFor(domain); if (d.ceiling<=0) return;
+        d.bucket.refill(Clock::now());
+        d.bucket.rate = backOff ? max(d.ceiling/16,d.bucket.rate/2) : min(d.ceiling,d.bucket.rate+d.ceiling/10);
+    }
+
+    void workLoop(){
+        while (true){
+            Job* job; int g; shared_ptr<const Message> msg; shared_ptr<const MailTransport::Render> render; string key;
+            {
+                unique_lock<mutex> lk(mu); size_t idx;
+                while (true){
+                    if (stopping) return;
+                    if (ready.empty()){ cv.wait(lk); continue; }
+                    auto now=Clock::now(), at=ready.front().at;
+                    if (at>now){ cv.wait_until(lk,at); continue; }
+                    idx=pop();
+                    if (admit(idx,now,at)) break;
+                    push(idx,at);                        // throttled: back in line
+                }
+                job=&jobs[idx]; job->state=Sending;
+                g=job->group-1; msg=groups[g].msg; render=groups[g].render; key=groups[g].key;
+            }
+            const vector<string>& rcpts=job->rcpts;
+            vector<MailTransport::Outcome> outcome(rcpts.size(),MailTransport::Transient);
+            string err;
+            MailTransport::Report report=[&](size_t i, MailTransport::Outcome o, const string& why){
+                outcome[i]=o;
+                if (o==MailTransport::Accepted){ if (outbox.isOpen()) outbox.delivered(key,rcpts[i]); return; }
+                if (err.empty()) err=rcpts[i]+": "+(why.empty()?"no reply":why);
+                if (o==MailTransport::Permanent && outbox.isOpen()) outbox.rejected(key,rcpts[i],why);
+            };
+            if (render) transport->deliverEach(rcpts,*render,report);
+            else transport->deliver(msg->subject,msg->body,rcpts,report);
+
+            vector<string> retry; size_t ok=0, bounced=0;
+            for (size_t i=0;i<rcpts.size();i++){
+                if (outcome[i]==MailTransport::Accepted) ok++;
+                else if (outcome[i]==MailTransport::Permanent) bounced++;
+                else retry.push_back(rcpts[i]);
+            }
+            bool giveUp = !retry.empty() && job->attempt+1>=kMaxAttempts;
+            if (giveUp && outbox.isOpen()) for (const auto& r: retry) outbox.rejected(key,r,"gave up after "+to_string(kMaxAttempts)+" attempts: "+err);
+            lock_guard<mutex> lk(mu);
+            job->delivered=ok; job->bounced=bounced+(giveUp?retry.size():0); job->error=err;
+            job->state = retry.empty() ? (bounced ? Failed : Sent) : giveUp ? Failed : Deferred;
+            Group& grp=groups[g];
+            grp.settled += job->delivered+job->bounced;
+            if (limited) adapt(job->domain,!retry.empty());
+            if (!retry.empty() && !giveUp){
+                jobs.push_back({job->group,move(retry),job->attempt+1,job->domain});
+                grp.jobs++; push(jobs.size()-1,Clock::now()+retryBase*(1<<job->attempt));
+            }
+            if (grp.settled==grp.recipients && outbox.isOpen()){
+                outbox.finished(key);
+                // Idle: nothing is in flight, so the journal shrinks to keys.
+                if (all_of(groups.begin(),groups.end(),[](const Group& x){ return x.settled==x.recipients; })){
+                    vector<string> keys(finishedKeys.begin(),finishedKeys.end());
+                    for (const auto& x: groups) keys.push_back(x.key);
+                    outbox.rewrite(keys,{});
+                }
+            }
+        }
+    }
+
+public:
+    ReminderPipeline(unique_ptr<MailTransport> t, int workerCount=8, size_t batch=500, chrono::milliseconds retryAfter=chrono::seconds(30)):
+        transport(move(t)), batchSize(max<size_t>(batch,1)), retryBase(retryAfter) {
+        for (int i=0;i<max(workerCount,1);i++) workers.emplace_back([this]{ workLoop(); });
+    }
+
+    // In-flight batches finish; queued and delayed ones are abandoned (with
+    // an outbox they stay journaled and resume on the next start).
+    ~ReminderPipeline(){
+        {
+            lock_guard<mutex> lk(mu); stopping=true;
+            for (const auto& r: ready){ jobs[r.job].state=Failed; jobs[r.job].error = outbox.isOpen() ? "left in outbox at shutdown" : "cancelled at shutdown"; }
+            ready.clear();
+        }
+        cv.notify_all(); for (auto& w: workers) w.join();
+    }
+
+    // Attach the journal at `file` and re-queue every unfinished group.
+    // revive() rebuilds a personalized renderer from its recipe. Returns
+    // the number of groups resumed, or -1 if the outbox can't be written.
+    int attachOutbox(const string& file, const Revive& revive){
+        vector<ReminderOutbox::Unfinished> open; set<string> done;
+        if (!outbox.open(file,open,done)) return -1;
+        int resumed=0;
+        {
+            lock_guard<mutex> lk(mu);
+            finishedKeys.swap(done);
+        }
+        for (auto& u: open){
+            shared_ptr<const MailTransport::Render> render;
+            if (!u.recipe.empty()){
+                MailTransport::Render r = revive ? revive(u.recipe) : nullptr;
+                if (!r) continue;
+                render=make_shared<const MailTransport::Render>(move(r));
+            }
+            Group g{u.key,u.label,render ? nullptr : make_shared<const Message>(Message{u.subject,u.body}),render};
+            g.resumed=true;
+            enqueue(move(g),u.rcpts,"",false);
+            resumed++;
+        }
+        return resumed;
+    }
+
+    // Journal to `file` from the first submission on. For a file that
+    // doesn't exist yet: there is nothing in it to resume.
+    void attachOutboxLazily(const string& file){ lock_guard<mutex> lk(mu); lazyOutbox=file; }
+
+    // Queue one rendered message for every recipient; returns the group id.
+    // A non-empty key makes the submission idempotent: a key already queued
+    // (or finished in an earlier run) is not sent again (0 if finished).
+    int submit(const string& subject, const string& body, const vector<string>& rcpts, const string& key=""){
+        return enqueue({key,subject,make_shared<const Message>(Message{subject,body}),nullptr},rcpts,"",true);
+    }
+
+    // Personalized: render runs on the workers, once per recipient, so the
+    // rendered messages never all sit in memory. `label` names the group;
+    // `recipe` is what the outbox keeps to rebuild render after a restart.
+    int submitPersonalized(const string& label, const vector<string>& rcpts, MailTransport::Render render, const string& recipe){
+        return enqueue({"",label,nullptr,make_shared<const MailTransport::Render>(move(render))},rcpts,recipe,true);
+    }
+
+private:
+    static string domainOf(const string& rcpt){ size_t at=rcpt.rfind('@'); return at==string::npos ? string() : toLower(rcpt.substr(at+1)); }
+
+    // Batches are cut from recipients ordered by domain, so a batch touches as
+    // few destination hosts (and pooled sessions) as possible. A recipient
+    // listed twice gets one message.
+    int enqueue(Group g, const vector<string>& unordered, const string& recipe, bool journal){
+        vector<pair<string,const string*>> keyed; keyed.reserve(unordered.size());
+        for (const auto& r: unordered) keyed.push_back({domainOf(r),&r});
+        sort(keyed.begin(),keyed.end(),[](const pair<string,const string*>& a, const pair<string,const string*>& b){
+            int c=a.first.compare(b.first); return c!=0 ? c<0 : *a.second<*b.second; });
+        vector<string> rcpts; vector<const string*> domains; rcpts.reserve(keyed.size());
+        for (const auto& k: keyed) if (rcpts.empty() || rcpts.back()!=*k.second){ rcpts.push_back(*k.second); domains.push_back(&k.first); }
+        if (g.key.empty()) g.key="m"+to_string(chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count())+"-"+to_string(++keySeq);
+        lock_guard<mutex> lk(mu);
+        if (journal){
+            if (!lazyOutbox.empty()){
+                // Groups another run left open stay in the file for its next start.
+                vector<ReminderOutbox::Unfinished> open; set<string> done;
+                if (outbox.open(lazyOutbox,open,done)) finishedKeys.insert(done.begin(),done.end());
+                lazyOutbox.clear();
+            }
+            auto it=groupByKey.find(g.key); if (it!=groupByKey.end()) return it->second;
+            if (finishedKeys.count(g.key)) return 0;
+            if (outbox.isOpen()) outbox.group(g.key,g.label,g.msg ? g.msg->subject : string(),g.msg ? g.msg->body : string(),recipe,rcpts);
+        }
+        int group=(int)groups.size()+1;
+        g.recipients=rcpts.size(); groupByKey[g.key]=group;
+        groups.push_back(move(g));
+        auto now=Clock::now();
+        for (size_t i=0, end; i<rcpts.size(); i=end){
+            end=min(i+batchSize,rcpts.size());
+            if (limited) for (size_t j=i+1;j<end;j++) if (*domains[j]!=*domains[i]){ end=j; break; }
+            jobs.push_back({group,vector<string>(rcpts.begin()+i,rcpts.begin()+end),0,limited ? *domains[i] : string()});
+            push(jobs.size()-1,now); groups.back().jobs++;
+        }
+        cv.notify_all();
+        return group;
+    }
+
+public:
+
+    // scope: "global", "*" (every domain not listed) or a domain. perSecond
+    // 0 removes the limit; burst defaults to one second's worth.
+    void setRateLimit(const string& scope, double perSecond, double burst=0){
+        lock_guard<mutex> lk(mu);
+        if (burst<=0) burst=perSecond;
+        if (scope=="global") global=TokenBucket(perSecond,burst);
+        else if (scope=="*") domainDefault={perSecond,burst};
+        else domainConfig[toLower(scope)]={perSecond,burst};
+        domainLimits.clear();
+        limited = !global.unlimited() || domainDefault.first>0 || any_of(domainConfig.begin(),domainConfig.end(),[](const pair<const string,pair<double,double>>& c){ return c.second.first>0; });
+    }
+
+    size_t queued() const { lock_guard<mutex> lk(mu); return ready.size(); }
+    string transportName() const { return transport->describe(); }
+
+    void report(ostream& os) const {
+        lock_guard<mutex> lk(mu);
+        auto now=Clock::now();
+        size_t waiting=count_if(ready.begin(),ready.end(),[&](const Ready& r){ return r.at>now; });
+        os<<"Transport: "<<transport->describe()<<", queued jobs: "<<ready.size()<<" ("<<waiting<<" waiting for retry or rate limit)\n";
+        if (outbox.isOpen()) os<<"Outbox: "<<outbox.file()<<"\n";
+        else if (!lazyOutbox.empty()) os<<"Outbox: "<<lazyOutbox<<" (created on the first send)\n";
+        else if (!outbox.file().empty()) os<<"Outbox: "<<outbox.file()<<" is not writable; sends are not journaled\n";
+        if (limited){
+            auto rate=[](double r){ return r>0 ? to_string((long long)r)+"/s" : string("unlimited"); };
+            os<<"Rate limits: global "<<rate(global.rate)<<", per domain "<<rate(domainDefault.first)<<", throttled waits "<<throttled<<"\n";
+            for (const auto& d: domainLimits) if (d.second.ceiling>0)
+                os<<"  "<<left<<setw(24)<<(d.first.empty()?"(no domain)":d.first)<<right<<rate(d.second.bucket.rate)<<" of "<<rate(d.second.ceiling)<<"\n";
+        }
+        if (groups.empty()){ os<<"No reminders submitted.\n"; return; }
+        vector<array<size_t,5>> byState(groups.size(),array<size_t,5>{});
+        vector<size_t> delivered(groups.size(),0), bounced(groups.size(),0); vector<string> firstError(groups.size());
+        for (const auto& j: jobs){
+            byState[j.group-1][j.state]++; delivered[j.group-1]+=j.delivered; bounced[j.group-1]+=j.bounced;
+            if (!j.error.empty() && firstError[j.group-1].empty()) firstError[j.group-1]=j.error;
+        }
+        for (size_t g=0; g<groups.size(); g++){
+            os<<"#"<<g+1<<" "<<groups[g].label<<(groups[g].resumed?" (resumed)":"")<<": jobs queued "<<byState[g][Queued]<<", sending "<<byState[g][Sending]<<", sent "<<byState[g][Sent]
+              <<", deferred "<<byState[g][Deferred]<<", failed "<<byState[g][Failed]
+              <<"; delivered "<<delivered[g]<<"/"<<groups[g].recipients<<", bounced "<<bounced[g]<<", pending "<<groups[g].recipients-groups[g].settled<<"\n";
+            if (!firstError[g].empty()) os<<"   first error: "<<firstError[g]<<(firstError[g].back()=='\n'?"":"\n");
+        }
+    }
+};
+
+// ------------------- Reminder templates -------------------
+// A template is parsed once into a flat instruction list: literal spans
+// (offsets into the source text) and field references. Rendering appends to
+// a caller-owned buffer, so a worker reusing one buffer per recipient does no
+// per-field allocation. Placeholders:
+//   {{date}} {{recipient}} {{email}} {{unsubscribe}}          anywhere
+//   {{#events}} ... {{/events}}                                repeated per event
+//   {{name}} {{time}} {{type}} {{location}} {{event_date}}     inside the block
+class MessageTemplate {
+public:
+    enum Field { Date, Recipient, Email, Unsubscribe, Name, Time, Type, Location, EventDate };
+
+    struct Context {
+        const string& date;                 // date or range label
+        const vector<Event>& events;
+        const string* email;                // null when rendering for everyone
+        const string& unsubscribeBase;
+    };
+
+private:
+    struct Op { enum Kind { Text, Put, Begin, End } kind; Field field; uint32_t off, len; };
+    string src;
+    vector<Op> ops;
+    bool perRecipient = false;
+
+    static void appendDisplayName(const string& email, string& out){
+        // "jane.doe_x@host" -> "Jane Doe X"
+        bool start=true; size_t at=email.find('@'); if (at==string::npos) at=email.size();
+        for (size_t i=0;i<at;i++){
+            char c=email[i];
+            if (c=='.'||c=='_'||c=='-'||c=='+'){ if (!start) out+=' '; start=true; continue; }
+            out += start ? (char)toupper((unsigned char)c) : c; start=false;
+        }
+        if (!out.empty() && out.back()==' ') out.pop_back();
+    }
+
+    static void appendUrlEncoded(const string& s, string& out){
+        static const char* hex="0123456789ABCDEF";
+        for (unsigned char c: s){
+            if (isalnum(c)||c=='-'||c=='_'||c=='.'||c=='~') out+=(char)c;
+            else { out+='%'; out+=hex[c>>4]; out+=hex[c&15]; }
+        }
+    }
+
+    void put(Field f, const Context& ctx, const Event* e, string& out) const {
+        switch (f){
+            case Date:        out+=ctx.date; break;
+            case Recipient:   if (ctx.email) appendDisplayName(*ctx.email,out); break;
+            case Email:       if (ctx.email) out+=*ctx.email; break;
+            case Unsubscribe: out+=ctx.unsubscribeBase; if (ctx.email){ out+=ctx.unsubscribeBase.find('?')==string::npos?'?':'&'; out+="email="; appendUrlEncoded(*ctx.email,out); } break;
+            case Name:        out+=e->name; break;
+            case Time:        out+=e->time; break;
+            case Type:        out+=e->type; break;
+            case Location:    out+= e->location.empty() ? "TBA" : e->location; break;
+            case EventDate:   out+=e->date; break;
+        }
+    }
+
+public:
+    // Returns false with err set on unknown placeholders or bad blocks.
+    bool compile(const string& text, string& err){
+        static const pair<const char*,Field> names[] = {
+            {"date",Date},{"recipient",Recipient},{"email",Email},{"unsubscribe",Unsubscribe},
+            {"name",Name},{"time",Time},{"type",Type},{"location",Location},{"event_date",EventDate}};
+        vector<Op> parsed; bool inBlock=false, personal=false;
+        size_t pos=0;
+        while (pos<text.size()){
+            size_t open=text.find("{{",pos);
+            if (open==string::npos) open=text.size();
+            if (open>pos) parsed.push_back({Op::Text,Date,(uint32_t)pos,(uint32_t)(open-pos)});
+            if (open==text.size()) break;
+            size_t close=text.find("}}",open+2);
+            if (close==string::npos){ err="unterminated placeholder at offset "+to_string(open); return false; }
+            string key=text.substr(open+2,close-open-2);
+            if (key=="#events"){ if (inBlock){ err="nested {{#events}}"; return false; } inBlock=true; parsed.push_back({Op::Begin,Date,0,0}); }
+            else if (key=="/events"){ if (!inBlock){ err="{{/events}} without {{#events}}"; return false; } inBlock=false; parsed.push_back({Op::End,Date,0,0}); }
+            else {
+                auto it=find_if(begin(names),end(names),[&](const pair<const char*,Field>& n){ return key==n.first; });
+                if (it==end(names)){ err="unknown placeholder {{"+key+"}}"; return false; }
+                if (it->second>=Name && !inBlock){ err="{{"+key+"}} is only valid inside {{#events}}"; return false; }
+                if (it->second==Recipient || it->second==Email || it->second==Unsubscribe) personal=true;
+                parsed.push_back({Op::Put,it->second,0,0});
+            }
+            pos=close+2;
+        }
+        if (inBlock){ err="missing {{/events}}"; return false; }
+        src=text; ops.swap(parsed); perRecipient=personal;
+        return true;
+    }
+
+    const string& source() const { return src; }
+    size_t heapBytes() const { return ::heapBytes(src)+ops.capacity()*sizeof(Op); }
+    bool personalized() const { return perRecipient; }
+
+    void render(const Context& ctx, string& out) const {
+        for (size_t i=0;i<ops.size();i++){
+            const Op& op=ops[i];
+            if (op.kind==Op::Text) out.append(src,op.off,op.len);
+            else if (op.kind==Op::Put) put(op.field,ctx,nullptr,out);
+            else if (op.kind==Op::Begin){
+                size_t end=i+1; while (ops[end].kind!=Op::End) end++;
+                for (const auto& e: ctx.events)
+                    for (size_t j=i+1;j<end;j++){
+                        if (ops[j].kind==Op::Text) out.append(src,ops[j].off,ops[j].len);
+                        else put(ops[j].field,ctx,&e,out);
+                    }
+                i=end;
+            }
+        }
+    }
+};
+
+struct ReminderTemplate {
+    MessageTemplate subject, body;
+    string unsubscribeBase = "https://example.invalid/unsubscribe";
+
+    ReminderTemplate(const string& subjectText, const string& bodyText){ string err; subject.compile(subjectText,err); body.compile(bodyText,err); }
+
+    // Defaults reproduce the classic per-date reminder and digest texts.
+    static ReminderTemplate classic(){ return {"Reminder: Events on {{date}}","Upcoming events on {{date}}:\n\n{{#events}}- {{time}} | {{name}} ({{type}}) @ {{location}}\n{{/events}}"}; }
+    static ReminderTemplate digest(){ return {"Your events {{date}}","Your upcoming events:\n\n{{#events}}- {{event_date}} {{time}} | {{name}} ({{type}}) @ {{location}}\n{{/events}}"}; }
+
+    bool personalized() const { return subject.personalized() || body.personalized(); }
+    size_t heapBytes() const { return subject.heapBytes()+body.heapBytes()+::heapBytes(unsubscribeBase); }
+
+    void render(const string& date, const vector<Event>& events, const string* email, string& subjectOut, string& bodyOut) const {
+        MessageTemplate::Context ctx{date,events,email,unsubscribeBase};
+        subject.render(ctx,subjectOut); body.render(ctx,bodyOut);
+    }
+};
+
+// ------------------- Reminder scheduler (hierarchical timer wheel) -------------------
+// Pending reminders keyed on the minute they fire. Four levels of 64 slots
+// cover ~32 years at one-minute resolution (later timers wait in an overflow
+// list); each slot is an intrusive doubly-linked list over a node pool, so
+// schedule and cancel are O(1) and advancing costs O(1) per elapsed minute
+// plus the timers that cascade or fire.
+class ReminderScheduler {
+public:
+    struct Due { int eventId; int offsetMin; long long fireAt; };
+
+private:
+    static const int kBits = 6, kSlots = 1<<kBits, kLevels = 4, kOverflow = kLevels*kSlots;
+    struct Node { long long fireAt; int eventId, offset; int prev, next, slot; };
+    vector<Node> nodes;
+    vector<int> freeNodes;
+    vector<int> heads = vector<int>(kOverflow+1,-1);
+    unordered_map<int,vector<int>> byEvent;      // event id -> its nodes
+    long long cur;                                // last processed minute
+    size_t live = 0;
+
+    int slotFor(long long when) const {
+        long long d = when-cur;
+        for (int level=0; level<kLevels; level++)
+            if (d < (1LL<<(kBits*(level+1)))) return level*kSlots + (int)((when>>(kBits*level)) & (kSlots-1));
+        return kOverflow;
+    }
+
+    // `floor` is the earliest tick the node may land on (cur while cascading,
+    // since that tick's level-0 slot is about to be processed).
+    void link(int n, long long floor){
+        Node& x = nodes[n];
+        x.slot = slotFor(max(x.fireAt,floor)); x.prev = -1; x.next = heads[x.slot];
+        if (x.next>=0) nodes[x.next].prev = n;
+        heads[x.slot] = n;
+    }
+
+    void unlink(int n){
+        Node& x = nodes[n];
+        if (x.prev>=0) nodes[x.prev].next = x.next; else heads[x.slot] = x.next;
+        if (x.next>=0) nodes[x.next].prev = x.prev;
+        x.slot = -1;
+    }
+
+    void release(int n){ unlink(n); freeNodes.push_back(n); live--; }
+
+    void cascade(int slot){
+        int n = heads[slot]; heads[slot] = -1;
+        while (n>=0){ int next = nodes[n].next; link(n,cur); n = next; }
+    }
+
+public:
+    explicit ReminderScheduler(long long nowMinute): cur(nowMinute) {}
+
+    // Drop everything and restart the clock at `sinceMinute`.
+    void reset(long long sinceMinute){
+        nodes.clear(); freeNodes.clear(); byEvent.clear(); live=0; cur=sinceMinute;
+        fill(heads.begin(),heads.end(),-1);
+    }
+
+    // One timer per offset (minutes before start); points already in the
+    // past, and every offset of an event that has started, are skipped.
+    void schedule(int eventId, long long startMinute, const vector<int>& offsets){
+        if (startMinute<=cur) return;
+        for (int off: offsets){
+            long long at = startMinute-off;
+            if (at<=cur) continue;
+            int n;
+            if (!freeNodes.empty()){ n=freeNodes.back(); freeNodes.pop_back(); nodes[n]={at,eventId,off,-1,-1,-1}; }
+            else { n=(int)nodes.size(); nodes.push_back({at,eventId,off,-1,-1,-1}); }
+            link(n,cur+1); byEvent[eventId].push_back(n); live++;
+        }
+    }
+
+    void cancel(int eventId){
+        auto it = byEvent.find(eventId); if (it==byEvent.end()) return;
+        for (int n: it->second) release(n);
+        byEvent.erase(it);
+    }
+
+    // Process every minute up to nowMinute, appending fired timers to `due`.
+    void advance(long long nowMinute, vector<Due>& due){
+        while (cur<nowMinute){
+            cur++;
+            // Refill lower levels when a higher level's slot comes due.
+            for (int level=1; level<=kLevels; level++){
+                if ((cur & ((1LL<<(kBits*level))-1))!=0) break;
+                cascade(level==kLevels ? kOverflow : level*kSlots + (int)((cur>>(kBits*level)) & (kSlots-1)));
+            }
+            int slot = (int)(cur & (kSlots-1));
+            for (int n=heads[slot]; n>=0; ){
+                int next = nodes[n].next;
+                const Node& x = nodes[n];
+                if (x.fireAt<=cur){
+                    due.push_back({x.eventId,x.offset,x.fireAt});
+                    auto& mine = byEvent[x.eventId]; mine.erase(std::remove(mine.begin(),mine.end(),n),mine.end());
+                    if (mine.empty()) byEvent.erase(x.eventId);
+                    release(n);
+                }
+                n = next;
+            }
+        }
+    }
+
+    size_t pending() const { return live; }
+    long long now() const { return cur; }
+    size_t memoryBytes() const { return nodes.capacity()*sizeof(Node) + heads.capacity()*sizeof(int) + byEvent.size()*(sizeof(pair<const int,vector<int>>)+32) + live*sizeof(int); }
+
+    // Earliest pending fire time (LLONG_MAX if none). Within a level, slots
+    // after the cursor are in time order and the cursor's own slot may hold
+    // the block one lap ahead, so per level only those two slots are read:
+    // O(kLevels*kSlots) plus their lists and the overflow list.
+    long long nextDue() const {
+        long long best = LLONG_MAX;
+        auto scan=[&](int slot){ for (int n=heads[slot]; n>=0; n=nodes[n].next) best = min(best,nodes[n].fireAt); };
+        for (int level=0; level<kLevels; level++){
+            int at = (int)((cur>>(kBits*level)) & (kSlots-1));
+            scan(level*kSlots+at);
+            for (int i=1; i<kSlots; i++){ int s = level*kSlots + ((at+i) & (kSlots-1)); if (heads[s]>=0){ scan(s); break; } }
+        }
+        scan(kOverflow);
+        return best;
+    }
+};
+
+// ------------------- Trace spans -------------------
+// Built with -DEVENT_TRACING, TRACE_SPAN("phase") records the enclosing
+// scope into a per-thread ring (the newest kRing spans per thread survive)
+// and traceDump() writes them as Chrome trace JSON for chrome://tracing or
+// Perfetto. Without the flag the macro expands to nothing and traceDump()
+// reports that tracing is off. Timed operations (OpTimer) open a span
+// named after the operation, so phases nest under it.
+#ifdef EVENT_TRACING
+class TraceLog {
+    struct Span { const char* name; uint64_t startNs, durNs; };
+    static const size_t kRing = 1<<15;
+    struct Ring { array<Span,kRing> spans; atomic<uint64_t> head{0}; int tid; };
+    mutable mutex mu;
+    vector<unique_ptr<Ring>> rings;            // kept after their thread exits
+    const chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+
+    Ring& local(){
+        thread_local Ring* mine=nullptr;       // one TraceLog per process
+        if (!mine){ lock_guard<mutex> lk(mu); rings.push_back(make_unique<Ring>()); mine=rings.back().get(); mine->tid=(int)rings.size(); }
+        return *mine;
+    }
+
+public:
+    uint64_t now() const { return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now()-epoch).count(); }
+    size_t memoryBytes() const { lock_guard<mutex> lk(mu); return sizeof(*this)+rings.size()*sizeof(Ring); }
+
+    void record(const char* name, uint64_t startNs, uint64_t endNs){
+        Ring& r=local(); uint64_t h=r.head.load(memory_order_relaxed);
+        r.spans[h%kRing]={name,startNs,endNs-startNs};
+        r.head.store(h+1,memory_order_release);
+    }
+
+    // Spans a writer may have overwritten during the copy are dropped. Span
+    // names are string literals, so they go out unescaped.
+    void dump(ostream& os) const {
+        lock_guard<mutex> lk(mu); string js="{\"displayTimeUnit\":\"ns\",\"traceEvents\":["; char b[160];
+        for (const auto& r: rings){
+            uint64_t head=r->head.load(memory_order_acquire), from = head>kRing ? head-kRing : 0;
+            vector<Span> copy; copy.reserve((size_t)(head-from));
+            for (uint64_t i=from;i<head;i++) copy.push_back(r->spans[i%kRing]);
+            uint64_t after=r->head.load(memory_order_acquire), safe = after>kRing ? after-kRing : 0;
+            size_t skip = safe>from ? (size_t)min<uint64_t>(safe-from,copy.size()) : 0;
+            snprintf(b,sizeof b,"%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",js.back()=='[' ? "" : ",",r->tid,r->tid);
+            js+=b;
+            for (size_t i=skip;i<copy.size();i++){
+                snprintf(b,sizeof b,",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"name\":\"%s\",\"ts\":%.3f,\"dur\":%.3f}",r->tid,copy[i].name,copy[i].startNs/1e3,copy[i].durNs/1e3);
+                js+=b;
+            }
+        }
+        js+="\n]}\n"; os<<js;
+    }
+};
+
+static TraceLog traceLog;
+
+class TraceScope {
+    const char* name; uint64_t t0;
+public:
+    explicit TraceScope(const char* n): name(n), t0(traceLog.now()) {}
+    ~TraceScope(){ traceLog.record(name,t0,traceLog.now()); }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#define TRACE_CONCAT2(a,b) a##b
+#define TRACE_CONCAT(a,b) TRACE_CONCAT2(a,b)
+#define TRACE_SPAN(name) TraceScope TRACE_CONCAT(traceSpan_,__LINE__)(name)
+static bool traceDump(ostream& os){ traceLog.dump(os); return true; }
+static size_t traceBytes(){ return traceLog.memoryBytes(); }
+#else
+#define TRACE_SPAN(name) ((void)0)
+static bool traceDump(ostream&){ return false; }
+static size_t traceBytes(){ return 0; }
+#endif
+
+// ------------------- Table output -------------------
+// Listing rows are formatted straight into one reused buffer and handed to
+// the stream in 64 KiB writes. Cells are padded by hand and measured in
+// UTF-8 code points, so a multi-byte name or the "…" marker doesn't shift
+// the columns after it.
+class OutBuf {
+    static const size_t kFlushAt = 1<<16;
+    ostream& os;
+    string buf;
+
+public:
+    explicit OutBuf(ostream& o): os(o) { buf.reserve(kFlushAt+256); }
+    ~OutBuf(){ flush(); }
+    OutBuf(const OutBuf&) = delete;
+    OutBuf& operator=(const OutBuf&) = delete;
+
+    void flush(){ if (!buf.empty()){ TRACE_SPAN("output.flush"); os.write(buf.data(),(streamsize)buf.size()); buf.clear(); } }
+    void put(string_view s){ buf.append(s.data(),s.size()); }
+    void pad(size_t n){ buf.append(n,' '); }
+    void endRow(){ buf+='\n'; if (buf.size()>=kFlushAt) flush(); }
+
+    // Left-aligned cell `width` columns wide; text longer than `fit` code
+    // points is cut to fit-1 of them plus "…".
+    void cell(string_view s, size_t fit, size_t width){
+        if (s.size()<=fit){                                          // fits even as bytes
+            size_t cols=s.size(); for (char c: s) cols -= ((unsigned char)c&0xC0)==0x80;
+            put(s); pad(width-cols); return;
+        }
+        size_t cols=0, cut=s.size();
+        for (size_t i=0; i<s.size(); i++){
+            if (((unsigned char)s[i]&0xC0)==0x80) continue;         // continuation byte
+            if (cols==fit-1) cut=i;
+            if (++cols>fit) break;
+        }
+        if (cols<=fit){ put(s); pad(width>cols ? width-cols : 0); return; }
+        put(s.substr(0,cut)); put("…"); pad(width>fit ? width-fit : 0);
+    }
+
+    void number(long long v, size_t width){
+        char tmp[24]; char* e=tmp+sizeof tmp; char* p=e; bool neg=v<0; unsigned long long u = neg ? 0ULL-(unsigned long long)v : (unsigned long long)v;
+        do { *--p=(char)('0'+u%10); u/=10; } while (u);
+        if (neg) *--p='-';
+        size_t n=(size_t)(e-p); buf.append(p,n); pad(width>n ? width-n : 0);
+    }
+
+    // Field escapers for the machine formats; they copy runs of plain bytes
+    // straight into the buffer.
+    void csv(string_view s){
+        if (s.find_first_of(",\"\r\n")==string_view::npos){ put(s); return; }
+        put("\"");
+        for (size_t i=0, q; i<s.size(); i=q+1){
+            q=s.find('"',i); if (q==string_view::npos){ put(s.substr(i)); break; }
+            put(s.substr(i,q-i+1)); put("\"");
+        }
+        put("\"");
+    }
+
+    void tsv(string_view s){
+        size_t from=0;
+        for (size_t i=0; i<s.size(); i++){
+            const char* esc = s[i]=='\\' ? "\\\\" : s[i]=='\t' ? "\\t" : s[i]=='\n' ? "\\n" : nullptr;
+            if (esc){ put(s.substr(from,i-from)); put(esc); from=i+1; }
+        }
+        put(s.substr(from));
+    }
+
+    void json(string_view s){
+        static const char* hex="0123456789abcdef";
+        put("\""); size_t from=0;
+        for (size_t i=0; i<s.size(); i++){
+            unsigned char c=(unsigned char)s[i];
+            if (c!='"' && c!='\\' && c>=0x20) continue;
+            put(s.substr(from,i-from)); from=i+1;
+            if (c=='"') put("\\\""); else if (c=='\\') put("\\\\"); else if (c=='\n') put("\\n"); else if (c=='\t') put("\\t");
+            else { char u[6]={'\\','u','0','0',hex[c>>4],hex[c&15]}; put(string_view(u,6)); }
+        }
+        put(s.substr(from)); put("\"");
+    }
+};
+
+enum class OutputFormat { Table, Csv, Tsv, Json };
+
+static const char* formatName(OutputFormat f){
+    switch (f){ case OutputFormat::Csv: return "csv"; case OutputFormat::Tsv: return "tsv"; case OutputFormat::Json: return "json"; default: return "table"; }
+}
+
+static bool parseOutputFormat(const string& s, OutputFormat& f){
+    for (OutputFormat c: {OutputFormat::Table,OutputFormat::Csv,OutputFormat::Tsv,OutputFormat::Json}) if (iequals(s,formatName(c))){ f=c; return true; }
+    return false;
+}
+
+// Streams event rows onto an OutBuf in one format: the fixed-width table,
+// CSV (RFC 4180 quoting), TSV (\\ \t \n escaped like the log records) or a
+// JSON array with one object per line. Fields are escaped by OutBuf while
+// they are copied; the footer is written on destruction.
+class EventWriter {
+    OutBuf& ob;
+    OutputFormat fmt;
+    size_t rows = 0;
+
+public:
+    EventWriter(OutBuf& o, OutputFormat f): ob(o), fmt(f) {
+        switch (fmt){
+            case OutputFormat::Table:
+                ob.put("ID   Name                  Date        Time    Type          Location          "); ob.endRow();
+                ob.put("-------------------------------------------------------------------------------"); ob.endRow(); break;
+            case OutputFormat::Csv: ob.put("id,name,date,time,type,location"); ob.endRow(); break;
+            case OutputFormat::Tsv: ob.put("id\tname\tdate\ttime\ttype\tlocation"); ob.endRow(); break;
+            case OutputFormat::Json: ob.put("["); break;
+        }
+    }
+
+    ~EventWriter(){ if (fmt==OutputFormat::Json){ if (rows) ob.endRow(); ob.put("]"); ob.endRow(); } }
+    EventWriter(const EventWriter&) = delete;
+    EventWriter& operator=(const EventWriter&) = delete;
+
+    void row(const Event& e){
+        switch (fmt){
+            case OutputFormat::Table:
+                ob.number(e.id,5); ob.cell(e.name,20,22); ob.cell(e.date,12,12); ob.cell(e.time,8,8); ob.cell(e.type,12,14); ob.cell(e.location,16,18);
+                break;
+            case OutputFormat::Csv:
+                ob.number(e.id,0); ob.put(","); ob.csv(e.name); ob.put(","); ob.csv(e.date); ob.put(","); ob.csv(e.time); ob.put(","); ob.csv(e.type); ob.put(","); ob.csv(e.location);
+                break;
+            case OutputFormat::Tsv:
+                ob.number(e.id,0); ob.put("\t"); ob.tsv(e.name); ob.put("\t"); ob.tsv(e.date); ob.put("\t"); ob.tsv(e.time); ob.put("\t"); ob.tsv(e.type); ob.put("\t"); ob.tsv(e.location);
+                break;
+            case OutputFormat::Json:
+                if (rows) ob.put(",");
+                ob.endRow();
+                ob.put("{\"id\":"); ob.number(e.id,0); ob.put(",\"name\":"); ob.json(e.name); ob.put(",\"date\":"); ob.json(e.date);
+                ob.put(",\"time\":"); ob.json(e.time); ob.put(",\"type\":"); ob.json(e.type); ob.put(",\"location\":"); ob.json(e.location); ob.put("}");
+                rows++;
+                return;
+        }
+        ob.endRow(); rows++;
+    }
+};
+
+// ------------------- Operation latency -------------------
+// HDR-style histograms of EventManager operations: exact below 32 ns, then
+// 16 linear sub-buckets per power of two (<= 6.25% error) up to ~18 minutes.
+// Each thread records into its own shard (single writer, relaxed atomics,
+// no shared cache lines); readers merge every shard. Interactive operations
+// (edit, paste import) are not timed since they would measure the user, nor
+// is isDuplicate, a sub-microsecond step of every add.
+enum OpId { OpAdd, OpDelete, OpDeleteByName, OpDayView, OpWeekView, OpMonthView, OpListAll, OpSearch,
+            OpStatistics, OpSuggest, OpExport, OpRegister, OpRemind, OpDigest, OpSave, OpLoad, kOpCount };
+static const char* const kOpNames[kOpCount] = {"addEvent","deleteById","deleteByName","dayView","weekView","monthView",
+    "listAll","search","statistics","suggestSlots","exportCSV","registerAttendees","sendReminder","sendDigest","saveTo","loadFrom"};
+
+static string fmtNanos(double ns){
+    char b[32];
+    if (ns<1e3) snprintf(b,sizeof b,"%.0fns",ns);
+    else if (ns<1e6) snprintf(b,sizeof b,"%.1fus",ns/1e3);
+    else if (ns<1e9) snprintf(b,sizeof b,"%.1fms",ns/1e6);
+    else snprintf(b,sizeof b,"%.2fs",ns/1e9);
+    return b;
+}
+
+class LatencyStats {
+public:
+    static const int kBuckets = 592;                       // covers [0, 2^40) ns
+
+    static int bucketOf(uint64_t ns){
+        if (ns<32) return (int)ns;
+        ns = min<uint64_t>(ns,(1ULL<<40)-1);
+        int e = 63-__builtin_clzll(ns);
+        return (e-4)*16 + (int)(ns>>(e-4));                 // top five bits are 16..31
+    }
+    static uint64_t upperEdge(int i){
+        if (i<32) return (uint64_t)i;
+        int shift=i/16-1; uint64_t top=(uint64_t)(i%16+16);
+        return ((top+1)<<shift)-1;
+    }
+
+    struct Summary {
+        uint64_t count=0, maxNs=0, sumNs=0;
+        array<uint64_t,kBuckets> buckets{};
+        // Upper edge of the bucket holding quantile q, capped at the max seen.
+        uint64_t quantile(double q) const {
+            if (!count) return 0;
+            uint64_t rank=(uint64_t)ceil(q*count), seen=0;
+            for (int i=0;i<kBuckets;i++){ seen+=buckets[i]; if (seen>=max<uint64_t>(rank,1)) return min(upperEdge(i),maxNs); }
+            return maxNs;
+        }
+    };
+
+private:
+    struct Shard {
+        atomic<uint64_t> buckets[kOpCount][kBuckets];
+        atomic<uint64_t> count[kOpCount], sumNs[kOpCount], maxNs[kOpCount];
+    };
+    mutable mutex mu;
+    vector<unique_ptr<Shard>> shards;          // kept after their thread exits
+
+    static void bump(atomic<uint64_t>& a, uint64_t by){ a.store(a.load(memory_order_relaxed)+by,memory_order_relaxed); }
+
+    Shard& local(){
+        thread_local Shard* mine=nullptr;      // one LatencyStats per process
+        if (!mine){ lock_guard<mutex> lk(mu); shards.push_back(make_unique<Shard>()); mine=shards.back().get(); }
+        return *mine;
+    }
+
+public:
+    void record(OpId op, uint64_t ns){
+        Shard& s=local();
+        bump(s.buckets[op][bucketOf(ns)],1); bump(s.count[op],1); bump(s.sumNs[op],ns);
+        if (ns>s.maxNs[op].load(memory_order_relaxed)) s.maxNs[op].store(ns,memory_order_relaxed);
+    }
+
+    size_t memoryBytes() const { lock_guard<mutex> lk(mu); return sizeof(*this)+shards.size()*sizeof(Shard); }
+
+    Summary summary(OpId op) const {
+        Summary sum; lock_guard<mutex> lk(mu);
+        for (const auto& s: shards){
+            sum.count+=s->count[op].load(memory_order_relaxed); sum.sumNs+=s->sumNs[op].load(memory_order_relaxed);
+            sum.maxNs=max(sum.maxNs,s->maxNs[op].load(memory_order_relaxed));
+            for (int i=0;i<kBuckets;i++) sum.buckets[i]+=s->buckets[op][i].load(memory_order_relaxed);
+        }
+        return sum;
+    }
+
+    // Ops never called are left out. Machine formats report nanoseconds.
+    void report(ostream& os, OutputFormat fmt) const {
+        OutBuf ob(os); bool any=false;
+        static const char* cols[] = {"op","count","mean_ns","p50_ns","p99_ns","p999_ns","max_ns"};
+        auto right=[&](const string& t){ ob.pad(t.size()<10 ? 10-t.size() : 1); ob.put(t); };
+        if (fmt==OutputFormat::Table){ ob.put("Operation              count      mean       p50       p99      p999       max"); ob.endRow(); }
+        else if (fmt==OutputFormat::Json) ob.put("[");
+        else { for (int c=0;c<7;c++){ if (c) ob.put(fmt==OutputFormat::Tsv ? "\t" : ","); ob.put(cols[c]); } ob.endRow(); }
+        for (int op=0; op<kOpCount; op++){
+            Summary m=summary((OpId)op); if (!m.count) continue;
+            uint64_t v[6] = {m.count, m.sumNs/m.count, m.quantile(0.5), m.quantile(0.99), m.quantile(0.999), m.maxNs};
+            if (fmt==OutputFormat::Table){
+                ob.cell(kOpNames[op],18,18); right(to_string(v[0]));
+                for (int c=1;c<6;c++) right(fmtNanos((double)v[c]));
+            } else if (fmt==OutputFormat::Json){
+                ob.put(any ? ",\n{" : "\n{"); ob.put("\"op\":"); ob.json(kOpNames[op]);
+                for (int c=0;c<6;c++){ ob.put(",\""); ob.put(cols[c+1]); ob.put("\":"); ob.number((long long)v[c],0); }
+                ob.put("}");
+            } else {
+                const char* sep = fmt==OutputFormat::Tsv ? "\t" : ",";
+                ob.put(kOpNames[op]); for (int c=0;c<6;c++){ ob.put(sep); ob.number((long long)v[c],0); }
+            }
+            if (fmt!=OutputFormat::Json) ob.endRow();
+            any=true;
+        }
+        if (fmt==OutputFormat::Json){ ob.put(any ? "\n]" : "]"); ob.endRow(); }
+        else if (!any && fmt==OutputFormat::Table){ ob.put("(no operations recorded yet)"); ob.endRow(); }
+    }
+};
+
+static LatencyStats opLatency;
+
+// Times the enclosing scope into opLatency.
+class OpTimer {
+#ifdef EVENT_TRACING
+    TraceScope span;
+#endif
+    OpId op; chrono::steady_clock::time_point t0;
+public:
+#ifdef EVENT_TRACING
+    explicit OpTimer(OpId o): span(kOpNames[o]), op(o), t0(chrono::steady_clock::now()) {}
+#else
+    explicit OpTimer(OpId o): op(o), t0(chrono::steady_clock::now()) {}
+#endif
+    ~OpTimer(){ opLatency.record(op,(uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now()-t0).count()); }
+    OpTimer(const OpTimer&) = delete;
+    OpTimer& operator=(const OpTimer&) = delete;
+};
+
+// ------------------- Memory accounting -------------------
+// Footprints are reported as named parts (O(1) estimates kept alongside the
+// data) so capacity planning can see strings vs indexes vs attendee lists.
+struct MemoryPart { const char* name; size_t bytes; };
+
+static string fmtBytes(size_t n){
+    char b[32];
+    if (n<1024) snprintf(b,sizeof b,"%zu B",n);
+    else if (n<(1u<<20)) snprintf(b,sizeof b,"%.1f KiB",n/1024.0);
+    else if (n<(1u<<30)) snprintf(b,sizeof b,"%.1f MiB",n/1048576.0);
+    else snprintf(b,sizeof b,"%.2f GiB",n/1073741824.0);
+    return b;
+}
+
+// Parts in the given order plus a total; machine formats report raw bytes.
+static void writeMemoryReport(ostream& os, const vector<MemoryPart>& parts, OutputFormat fmt){
+    size_t total=0; for (const auto& p: parts) total+=p.bytes;
+    OutBuf ob(os);
+    auto right=[&](const string& t, size_t w){ ob.pad(t.size()<w ? w-t.size() : 1); ob.put(t); };
+    if (fmt==OutputFormat::Table){
+        ob.put("Subsystem                 bytes   share"); ob.endRow();
+        for (const auto& p: parts){
+            char share[16]; snprintf(share,sizeof share,"%.1f%%",total ? 100.0*p.bytes/total : 0.0);
+            ob.cell(p.name,20,20); right(fmtBytes(p.bytes),11); right(share,8); ob.endRow();
+        }
+        ob.cell("total",20,20); right(fmtBytes(total),11); ob.endRow();
+    } else if (fmt==OutputFormat::Json){
+        ob.put("{\"total\":"); ob.number((long long)total,0); ob.put(",\"parts\":[");
+        for (size_t i=0;i<parts.size();i++){ ob.put(i ? ",{\"subsystem\":" : "{\"subsystem\":"); ob.json(parts[i].name); ob.put(",\"bytes\":"); ob.number((long long)parts[i].bytes,0); ob.put("}"); }
+        ob.put("]}"); ob.endRow();
+    } else {
+        const char* sep = fmt==OutputFormat::Tsv ? "\t" : ",";
+        ob.put("subsystem"); ob.put(sep); ob.put("bytes"); ob.endRow();
+        for (const auto& p: parts){ ob.put(p.name); ob.put(sep); ob.number((long long)p.bytes,0); ob.endRow(); }
+        ob.put("total"); ob.put(sep); ob.number((long long)total,0); ob.endRow();
+    }
+}
+
+class EventManager {
+    static uint64_t newUid(){ static atomic<uint64_t> n{0}; return ++n; }
+    const uint64_t id = newUid();     // identity for followers (addresses get reused)
+    vector<Event> events;
+    int nextId = 1;
+    vector<string> attendeeEmails; // loaded via paste
+    ReminderTemplate reminderTemplate = ReminderTemplate::classic(), digestTemplate = ReminderTemplate::digest();
+    // Per-event registrations, kept sorted by (event id, email) for merge joins.
+    vector<pair<int,string>> registrations;
+
+    // Memory accounting, maintained incrementally (see memoryBytes()).
+    size_t storeBytes = 0, logBytes = 0, attendeeBytes = 0, registrationBytes = 0;
+    size_t quotaBytes = 0;         // 0 = unlimited
+
+    // Mutation log: covers LSNs (logStart, lastLsn]. Anything older must be
+    // recovered from a checkpoint (full copy of the store).
+    deque<Mutation> mlog;
+    long long lastLsn = 0, logStart = 0;
+    static const size_t kLogCapacity = 100000;
+
+    void logMutation(Mutation::Op op, const Event& e){
+        TRACE_SPAN("log.append");
+        mlog.push_back({op, ++lastLsn, e}); logBytes += eventBytes(e);
+        if (mlog.size()>kLogCapacity){ logBytes -= eventBytes(mlog.front().e); mlog.pop_front(); logStart = mlog.front().lsn-1; }
+    }
+
+    // Bulk replacement (import) can't be expressed as a short log: bump the
+    // LSN and drop the log so followers fall back to a checkpoint.
+    void truncateLog(){ ++lastLsn; mlog.clear(); logBytes=0; logStart = lastLsn; }
+
+    // Per-day index: dayKey -> positions in `events`, ordered by start time,
+    // plus id -> position. Maintained incrementally on add/edit; erase moves
+    // the last event into the hole, so only that event's entries change.
+    map<int, vector<size_t>> dayIndex;
+    unordered_map<int,size_t> posById;
+
+    Event* findById(int id){ auto it=posById.find(id); return it==posById.end() ? nullptr : &events[it->second]; }
+
+    static bool slotLess(const Event& a, const Event& b){ return a.time!=b.time ? toMinutes(a.time)<toMinutes(b.time) : a.id<b.id; }
+
+    void indexInsert(size_t pos){
+        TRACE_SPAN("index.insert");
+        auto& v = dayIndex[dayKey(events[pos].date)];
+        v.insert(upper_bound(v.begin(),v.end(),pos,[&](size_t a,size_t b){ return slotLess(events[a],events[b]); }),pos);
+    }
+
+    void indexRemove(size_t pos, const string& date){
+        auto it = dayIndex.find(dayKey(date)); if (it==dayIndex.end()) return;
+        auto& v = it->second; v.erase(std::remove(v.begin(),v.end(),pos),v.end());
+        if (v.empty()) dayIndex.erase(it);
+    }
+
+    void eraseAt(size_t pos){
+        storeBytes -= eventBytes(events[pos]);
+        indexRemove(pos,events[pos].date); posById.erase(events[pos].id);
+        size_t last=events.size()-1;
+        if (pos!=last){
+            auto& v = dayIndex[dayKey(events[last].date)];
+            *find(v.begin(),v.end(),last) = pos;
+            events[pos]=move(events[last]); posById[events[pos].id]=pos;
+        }
+        events.pop_back();
+    }
+
+    void reindex(){
+        TRACE_SPAN("index.rebuild");
+        dayIndex.clear(); posById.clear(); storeBytes=0;
+        for (const auto& e: events) storeBytes += eventBytes(e);
+        for (size_t i=0;i<events.size();i++){ dayIndex[dayKey(events[i].date)].push_back(i); posById[events[i].id]=i; }
+        TRACE_SPAN("index.sort");
+        for (auto& d: dayIndex) sort(d.second.begin(),d.second.end(),[&](size_t a,size_t b){ return slotLess(events[a],events[b]); });
+    }
+
+    const vector<size_t>& slotsOn(const string& date) const {
+        static const vector<size_t> none;
+        auto it = dayIndex.find(dayKey(date)); return it==dayIndex.end() ? none : it->second;
+    }
+
+    // Push subscriptions.
+    vector<Subscription> subs;
+    int nextSubId = 1;
+
+    static bool inScope(const Subscription& s, const Event& e){
+        int k = dayKey(e.date);
+        return k>=s.fromDay && k<=s.toDay && (s.location.empty() || iequals(s.location,e.location));
+    }
+
+    // Automatic reminders: offsets in minutes before start; empty = disabled.
+    vector<int> reminderOffsets;
+    ReminderScheduler scheduler{nowMinute()};
+    size_t unsent = 0;             // fired with no attendees loaded, or after the event started
+
+    void dropRegistrations(int eventId){
+        auto lo = lower_bound(registrations.begin(),registrations.end(),make_pair(eventId,string()));
+        auto hi = lo; while (hi!=registrations.end() && hi->first==eventId){ registrationBytes -= sizeof(pair<int,string>)+heapBytes(hi->second); ++hi; }
+        registrations.erase(lo,hi);
+    }
+
+    void notify(const Event* before, const Event* after){
+        TRACE_SPAN("notify");
+        if (before && !after && !registrations.empty()) dropRegistrations(before->id);
+        if (!reminderOffsets.empty()){
+            if (before) scheduler.cancel(before->id);
+            if (after) scheduler.schedule(after->id,startMinute(*after),reminderOffsets);
+        }
+        for (const auto& s: subs){
+            bool was = before && inScope(s,*before), now = after && inScope(s,*after);
+            if (was && now) s.sink({ChangeNote::Updated,*after,s.id});
+            else if (now) s.sink({ChangeNote::Added,*after,s.id});
+            else if (was) s.sink({ChangeNote::Removed,*before,s.id});
+        }
+    }
+
+    // Single hook for every leader-side change: log it, then notify.
+    void changed(const Event* before, const Event* after){
+        if (after) logMutation(Mutation::Put,*after); else logMutation(Mutation::Erase,*before);
+        notify(before,after);
+    }
+
+public:
+    // ------------------- Validation -------------------
+    static bool isLeap(int y){ return (y%4==0 && y%100!=0) || (y%400==0); }
+
+    static bool isValidDate(const string& d){
+        // expect DD-MM-YYYY with digits and '-'
+        if (d.size()!=10 || d[2]!='-' || d[5]!='-') return false;
+        for (int i=0;i<10;i++){ if (i==2||i==5) continue; if (!isdigit((unsigned char)d[i])) return false; }
+        int day = stoi(d.substr(0,2));
+        int mon = stoi(d.substr(3,2));
+        int yr  = stoi(d.substr(6,4));
+        if (yr<1900 || yr>3000) return false;
+        if (mon<1 || mon>12) return false;
+        int mdays[] = {0,31,28,31,30,31,30,31,31,30,31,30,31};
+        if (mon==2 && isLeap(yr)) mdays[2]=29;
+        return day>=1 && day<=mdays[mon];
+    }
+
+    static bool isValidTime(const string& t){
+        // expect HH:MM with digits and ':'
+        if (t.size()!=5 || t[2] != ':') return false;
+        if (!isdigit((unsigned char)t[0]) || !isdigit((unsigned char)t[1]) ||
+            !isdigit((unsigned char)t[3]) || !isdigit((unsigned char)t[4])) return false;
+        int h = (t[0]-'0')*10 + (t[1]-'0');
+        int m = (t[3]-'0')*10 + (t[4]-'0');
+        if (h<0 || h>23) return false;
+        if (m<0 || m>59) return false;
+        return true;
+    }
+
+    static int toMinutes(const string& t){ return (t[0]-'0')*600 + (t[1]-'0')*60 + (t[3]-'0')*10 + (t[4]-'0'); }
+
+    static string fromMinutes(int minutes){
+        if (minutes<0) minutes=0;
+        minutes %= (24*60);
+        const char hhmm[5] = {char('0'+minutes/600), char('0'+minutes/60%10), ':', char('0'+minutes%60/10), char('0'+minutes%10)};
+        return string(hhmm,5);
+    }
+
+    // DD-MM-YYYY -> YYYYMMDD, so integer order is calendar order.
+    static int dayKey(const string& d){ return stoi(d.substr(6,4))*10000 + stoi(d.substr(3,2))*100 + stoi(d.substr(0,2)); }
+
+    static bool conflicts(const Event& a, const Event& b){
+        if (a.date!=b.date) return false;
+        int s1=toMinutes(a.time), e1=s1+60; // assume 60-minute events
+        int s2=toMinutes(b.time), e2=s2+60;
+        return (s1<e2 && s2<e1);
+    }
+
+    // ------------------- Utilities -------------------
+    static string today(){
+        using namespace chrono;
+        auto now = system_clock::now();
+        time_t tt = system_clock::to_time_t(now);
+        tm local{};
+        #ifdef _WIN32
+            localtime_s(&local, &tt);
+        #else
+            localtime_r(&tt, &local);
+        #endif
+        ostringstream os;
+        os<<setw(2)<<setfill('0')<<local.tm_mday<<"-"<<setw(2)<<setfill('0')<<(local.tm_mon+1)<<"-"<<(local.tm_year+1900);
+        return os.str();
+    }
+
+    static long long nowMinute(){ return (long long)(time(nullptr)/60); }
+
+    // Local start time of an event, in minutes since the epoch.
+    static long long startMinute(const Event& e){
+        tm t{}; t.tm_mday=stoi(e.date.substr(0,2)); t.tm_mon=stoi(e.date.substr(3,2))-1; t.tm_year=stoi(e.date.substr(6,4))-1900;
+        t.tm_hour=(e.time[0]-'0')*10+(e.time[1]-'0'); t.tm_min=(e.time[3]-'0')*10+(e.time[4]-'0'); t.tm_isdst=-1;
+        return (long long)(mktime(&t)/60);
+    }
+
+    // Read commands print their "No ..." message only for tables; machine
+    // formats always produce a (possibly empty) document.
+    static void printEvents(const vector<Event>& list, OutputFormat fmt){
+        TRACE_SPAN("output.rows");
+        OutBuf ob(out()); EventWriter w(ob,fmt);
+        for (const auto& e: list) w.row(e);
+    }
+
+    // ------------------- Core Ops -------------------
+private:
+    bool precheck(const string& name,const string& date,const string& time,bool verbose){
+        {
+            TRACE_SPAN("validate");
+            if (!isValidDate(date)){ if(verbose) out()<<"Invalid date. Use DD-MM-YYYY.\n"; return false; }
+            if (!isValidTime(time)){ if(verbose) out()<<"Invalid time. Use HH:MM (24h).\n"; return false; }
+        }
+        if (isDuplicate(name,date,time)){ if(verbose) out()<<"Duplicate event exists.\n"; return false; }
+        if (quotaBytes && memoryBytes()>=quotaBytes){ if(verbose) out()<<"Memory quota for this calendar is exhausted.\n"; return false; }
+        return true;
+    }
+
+    bool insertChecked(const Event& e,bool verbose){
+        TRACE_SPAN("check.conflict");
+        for (size_t p: slotsOn(e.date)){ const Event& ex=events[p]; if (conflicts(e,ex)){ if(verbose){ out()<<"Conflict with Event ID "<<ex.id<<" ("<<ex.name<<") at "<<ex.time<<".\n"; suggestSlots(e.date);} return false; } }
+        events.push_back(e); storeBytes += eventBytes(e); posById[e.id]=events.size()-1; indexInsert(events.size()-1); changed(nullptr,&events.back());
+        if(verbose) out()<<"Event added with ID: "<<e.id<<"\n";
+        return true;
+    }
+
+public:
+    bool isDuplicate(const string& name, const string& date, const string& time){
+        TRACE_SPAN("check.duplicate");
+        if (!isValidDate(date)) return false;   // stored events always have valid dates
+        for (size_t p: slotsOn(date)){ const Event& e=events[p]; if (iequals(e.name,name) && e.time==time) return true; }
+        return false;
+    }
+
+    bool addEvent(const string& name,const string& date,const string& time,const string& type,const string& location,bool verbose=true){
+        OpTimer timed(OpAdd);
+        if (!precheck(name,date,time,verbose)) return false;
+        return insertChecked(Event{nextId++,name,date,time,type,location},verbose);
+    }
+
+    // Same as addEvent with a caller-assigned id (the cluster router hands
+    // out ids that are unique across its workers).
+    bool addEventWithId(int id,const string& name,const string& date,const string& time,const string& type,const string& location,bool verbose=true){
+        OpTimer timed(OpAdd);
+        if (!precheck(name,date,time,verbose)) return false;
+        nextId = max(nextId,id+1);
+        return insertChecked(Event{id,name,date,time,type,location},verbose);
+    }
+
+    bool editEventById(int id){
+        Event* found = findById(id);
+        if (!found){ out()<<"Event not found.\n"; return false; }
+        Event backup=*found; Event &e=*found; string in;
+        out()<<"Editing Event (leave blank to keep current)\n";
+        out()<<"Name ["<<e.name<<"]: "; getline(cin,in); if(!in.empty()) e.name=in;
+        out()<<"Date ["<<e.date<<"]: "; getline(cin,in); if(!in.empty()) e.date=in;
+        out()<<"Time ["<<e.time<<"]: "; getline(cin,in); if(!in.empty()) e.time=in;
+        out()<<"Type ["<<e.type<<"]: "; getline(cin,in); if(!in.empty()) e.type=in;
+        out()<<"Location ["<<e.location<<"]: "; getline(cin,in); if(!in.empty()) e.location=in;
+        if (!isValidDate(e.date) || !isValidTime(e.time)){ out()<<"Invalid date/time. Reverting.\n"; e=backup; return false; }
+        for (size_t p: slotsOn(e.date)){ const Event& ex=events[p]; if (ex.id!=e.id && iequals(ex.name,e.name) && ex.time==e.time){ out()<<"Duplicate after edit. Reverting.\n"; e=backup; return false; } }
+        for (size_t p: slotsOn(e.date)){ const Event& ex=events[p]; if (ex.id!=e.id && conflicts(e,ex)){ out()<<"Conflict after edit with ID "<<ex.id<<". Reverting.\n"; suggestSlots(e.date); e=backup; return false; } }
+        size_t pos = found-events.data();
+        storeBytes += eventBytes(e); storeBytes -= eventBytes(backup);
+        indexRemove(pos,backup.date); indexInsert(pos); changed(&backup,&e);
+        out()<<"Event updated.\n"; return true;
+    }
+
+    bool deleteById(int id){
+        OpTimer timed(OpDelete);
+        Event* found = findById(id);
+        if (!found){ out()<<"No event with that ID.\n"; return false; }
+        Event gone=*found; eraseAt(found-events.data()); changed(&gone,nullptr);
+        out()<<"Deleted.\n"; return true;
+    }
+
+    bool deleteByName(const string& name){
+        OpTimer timed(OpDeleteByName);
+        auto gone = extractIf([&](const Event& e){return iequals(e.name,name);});
+        if (gone.empty()){ out()<<"No event with that name.\n"; return false; }
+        out()<<"Deleted.\n"; return true;
+    }
+
+    // Query helpers.
+    vector<Event> onDate(const string& date) const {
+        vector<Event> list; for (size_t p: slotsOn(date)) list.push_back(events[p]);
+        return list;
+    }
+
+    // Day-index order: date, then start time, then id.
+    static bool chronoLess(const Event& a, const Event& b){
+        int ka=dayKey(a.date), kb=dayKey(b.date);
+        return ka!=kb ? ka<kb : slotLess(a,b);
+    }
+
+    // Events on days [fromKey, toKey] (dayKey values), in chronoLess order.
+    vector<Event> between(int fromKey, int toKey) const {
+        vector<Event> list;
+        for (auto it=dayIndex.lower_bound(fromKey); it!=dayIndex.end() && it->first<=toKey; ++it)
+            for (size_t p: it->second) list.push_back(events[p]);
+        return list;
+    }
+
+    vector<Event> chronological() const { return between(INT_MIN,INT_MAX); }
+
+    // (date, number of events) for every day that has any.
+    vector<pair<string,size_t>> dayCounts() const {
+        vector<pair<string,size_t>> days;
+        for (const auto& d: dayIndex) days.push_back({events[d.second.front()].date,d.second.size()});
+        return days;
+    }
+
+    vector<Event> matching(const string& keyword) const {
+        vector<Event> list;
+        { TRACE_SPAN("search.scan"); for (const auto& e: events){ if (icontains(e.name,keyword) || icontains(e.type,keyword)) list.push_back(e); } }
+        TRACE_SPAN("search.sort");
+        sort(list.begin(),list.end(),[](const Event&a,const Event&b){return a.id<b.id;});
+        return list;
+    }
+
+    size_t size() const { return events.size(); }
+
+    // Remove and return every event matching pred.
+    template<class Pred> vector<Event> extractIf(Pred pred){
+        vector<Event> moved; for (const auto& e: events) if (pred(e)) moved.push_back(e);
+        if (moved.empty()) return moved;
+        events.erase(remove_if(events.begin(),events.end(),pred),events.end());
+        reindex();
+        for (const auto& e: moved) changed(&e,nullptr);
+        return moved;
+    }
+
+    // Register a watch over [fromDate, toDate] (optionally one location).
+    // With replay, current matches are sent first as Added, read straight
+    // from the day index. Returns the subscription id.
+    int subscribe(const string& fromDate, const string& toDate, const string& location, function<void(const ChangeNote&)> sink, bool replay=true){
+        Subscription s{nextSubId++, dayKey(fromDate), dayKey(toDate), location, move(sink)};
+        if (replay)
+            for (auto it=dayIndex.lower_bound(s.fromDay); it!=dayIndex.end() && it->first<=s.toDay; ++it)
+                for (size_t p: it->second) if (inScope(s,events[p])) s.sink({ChangeNote::Added,events[p],s.id});
+        subs.push_back(move(s));
+        return subs.back().id;
+    }
+
+    bool unsubscribe(int id){
+        auto before=subs.size();
+        subs.erase(remove_if(subs.begin(),subs.end(),[&](const Subscription& s){return s.id==id;}),subs.end());
+        return subs.size()!=before;
+    }
+
+    size_t subscriptionCount() const { return subs.size(); }
+    size_t dayCount() const { return dayIndex.size(); }
+    bool isBlank() const { return events.empty() && attendeeEmails.empty() && registrations.empty(); }
+
+    void dayView(const string& date, OutputFormat fmt=OutputFormat::Table){
+        OpTimer timed(OpDayView);
+        const vector<size_t>& slots=slotsOn(date);
+        if (slots.empty() && fmt==OutputFormat::Table){ out()<<"No events on this date.\n"; return; }
+        OutBuf ob(out()); EventWriter w(ob,fmt);
+        for (size_t p: slots) w.row(events[p]);
+    }
+
+    void todaysEvents(OutputFormat fmt=OutputFormat::Table){ dayView(today(),fmt); }
+
+    // The day index is already in chronological order: no copy, no sort.
+    void listAll(OutputFormat fmt=OutputFormat::Table){
+        OpTimer timed(OpListAll);
+        if (events.empty() && fmt==OutputFormat::Table){ out()<<"No events.\n"; return; }
+        TRACE_SPAN("output.rows");
+        OutBuf ob(out()); EventWriter w(ob,fmt);
+        for (const auto& d: dayIndex) for (size_t p: d.second) w.row(events[p]);
+    }
+
+    // ------------------- Calendar views -------------------
+    // Civil date <-> day number (days since 1970-01-01), proleptic Gregorian.
+    static long long daysFromCivil(int y, int m, int d){
+        y -= m<=2; long long era=(y>=0?y:y-399)/400; unsigned yoe=(unsigned)(y-era*400);
+        unsigned doy=(153*(m+(m>2?-3:9))+2)/5+d-1, doe=yoe*365+yoe/4-yoe/100+doy;
+        return era*146097+(long long)doe-719468;
+    }
+    static int keyFromDays(long long z){
+        z+=719468; long long era=(z>=0?z:z-146096)/146097; unsigned doe=(unsigned)(z-era*146097);
+        unsigned yoe=(doe-doe/1460+doe/36524-doe/146096)/365, doy=doe-(365*yoe+yoe/4-yoe/100), mp=(5*doy+2)/153;
+        int d=(int)(doy-(153*mp+2)/5+1), m=(int)(mp<10?mp+3:mp-9); long long y=(long long)yoe+era*400+(m<=2);
+        return (int)y*10000+m*100+d;
+    }
+    static long long daysFromKey(int key){ return daysFromCivil(key/10000,key/100%100,key%100); }
+    static int weekdayMon0(long long days){ return (int)(((days+3)%7+7)%7); }   // 1970-01-01 was a Thursday
+
+    void weekView(const string& date, OutputFormat fmt=OutputFormat::Table){
+        OpTimer timed(OpWeekView);
+        long long day=daysFromKey(dayKey(date)), monday=day-weekdayMon0(day);
+        int k=keyFromDays(monday); char title[32];
+        snprintf(title,sizeof title,"Week of %02d-%02d-%04d",k%100,k/100%100,k/10000);
+        calendarGrid(monday,monday+6,8,fmt,title);
+    }
+
+    // "MM-YYYY", or any DD-MM-YYYY date inside the month.
+    static bool parseMonth(const string& s, int& month, int& year){
+        string d = s.size()==7 ? "01-"+s : s;
+        if (!isValidDate(d)) return false;
+        int k=dayKey(d); month=k/100%100; year=k/10000; return true;
+    }
+
+    void monthView(int month, int year, OutputFormat fmt=OutputFormat::Table){
+        OpTimer timed(OpMonthView);
+        static const char* names[12]={"January","February","March","April","May","June","July","August","September","October","November","December"};
+        long long first=daysFromCivil(year,month,1), last=daysFromCivil(year+(month==12),month%12+1,1)-1;
+        calendarGrid(first,last,3,fmt,string(names[month-1])+" "+to_string(year));
+    }
+
+private:
+    // Days [from, to] laid out Monday..Sunday: per-day count plus the first
+    // `perDay` events, all read from the day index in a single forward pass
+    // (the index is already in slot order, so no sorting or copying).
+    void calendarGrid(long long from, long long to, size_t perDay, OutputFormat fmt, const string& title) const {
+        struct Day { int key; const vector<size_t>* slots; };
+        vector<Day> days; size_t total=0;
+        auto it=dayIndex.lower_bound(keyFromDays(from));
+        for (long long z=from; z<=to; z++){
+            int key=keyFromDays(z); const vector<size_t>* slots=nullptr;
+            if (it!=dayIndex.end() && it->first==key){ slots=&it->second; total+=slots->size(); ++it; }
+            days.push_back({key,slots});
+        }
+        auto count=[](const Day& d){ return d.slots ? d.slots->size() : (size_t)0; };
+        auto dateOf=[](int key, char* buf){ int n=snprintf(buf,16,"%02d-%02d-%04d",key%100,key/100%100,key/10000); return string_view(buf,(size_t)n); };
+        OutBuf ob(out()); char db[16];
+
+        if (fmt==OutputFormat::Json){
+            ob.put("{\"title\":"); ob.json(title); ob.put(",\"total\":"); ob.number((long long)total,0); ob.put(",\"days\":[");
+            for (size_t i=0;i<days.size();i++){
+                const Day& d=days[i];
+                ob.put(i?",":""); ob.endRow();
+                ob.put("{\"date\":\""); ob.put(dateOf(d.key,db)); ob.put("\",\"count\":"); ob.number((long long)count(d),0); ob.put(",\"events\":[");
+                for (size_t r=0; r<min(count(d),perDay); r++){
+                    const Event& e=events[(*d.slots)[r]];
+                    ob.put(r?",":""); ob.put("{\"id\":"); ob.number(e.id,0); ob.put(",\"time\":"); ob.json(e.time); ob.put(",\"name\":"); ob.json(e.name); ob.put("}");
+                }
+                ob.put("]}");
+            }
+            ob.endRow(); ob.put("]}"); ob.endRow();
+            return;
+        }
+        if (fmt!=OutputFormat::Table){                 // one row per (day, shown event)
+            bool tsv=fmt==OutputFormat::Tsv; const char* sep = tsv ? "\t" : ",";
+            ob.put(tsv ? "date\tcount\trank\tid\ttime\tname" : "date,count,rank,id,time,name"); ob.endRow();
+            for (const Day& d: days){
+                size_t shown=min(count(d),perDay);
+                for (size_t r=0; r<max<size_t>(shown,1); r++){
+                    ob.put(dateOf(d.key,db)); ob.put(sep); ob.number((long long)count(d),0); ob.put(sep);
+                    if (r<shown){
+                        const Event& e=events[(*d.slots)[r]];
+                        ob.number((long long)r+1,0); ob.put(sep); ob.number(e.id,0); ob.put(sep);
+                        if (tsv){ ob.tsv(e.time); ob.put(sep); ob.tsv(e.name); } else { ob.csv(e.time); ob.put(sep); ob.csv(e.name); }
+                    } else { ob.put(sep); ob.put(sep); ob.put(sep); }
+                    ob.endRow();
+                }
+            }
+            return;
+        }
+
+        // Table: 7 columns of 11; days outside [from, to] stay blank.
+        const size_t kCol=11;
+        ob.put(title); ob.put(": "); ob.number((long long)total,0); ob.put(total==1?" event":" events"); ob.endRow();
+        ob.put("Mon        Tue        Wed        Thu        Fri        Sat        Sun"); ob.endRow();
+        long long start=from-weekdayMon0(from);
+        for (long long week=start; week<=to; week+=7){
+            ob.put("-----------------------------------------------------------------------------"); ob.endRow();
+            size_t lines=0;
+            for (int c=0;c<7;c++){
+                long long z=week+c; char cell[16];
+                if (z<from || z>to){ ob.pad(kCol); continue; }
+                const Day& d=days[(size_t)(z-from)];
+                int n = count(d) ? snprintf(cell,sizeof cell,"%d (%zu)",d.key%100,count(d)) : snprintf(cell,sizeof cell,"%d",d.key%100);
+                ob.cell(string_view(cell,(size_t)n),kCol-1,kCol);
+                lines=max(lines,min(count(d),perDay));
+            }
+            ob.endRow();
+            for (size_t r=0;r<lines;r++){
+                for (int c=0;c<7;c++){
+                    long long z=week+c;
+                    const Day* d = z<from || z>to ? nullptr : &days[(size_t)(z-from)];
+                    if (!d || r>=min(count(*d),perDay)){ ob.pad(kCol); continue; }
+                    const Event& e=events[(*d->slots)[r]];
+                    char label[64]; int n=snprintf(label,sizeof label,"%s %s",e.time.c_str(),e.name.c_str());
+                    if (n>=(int)sizeof label) n=(int)sizeof label-1;
+                    ob.cell(string_view(label,(size_t)n),kCol-1,kCol);
+                }
+                ob.endRow();
+            }
+        }
+    }
+
+public:
+    void search(const string& keyword, OutputFormat fmt=OutputFormat::Table){
+        OpTimer timed(OpSearch);
+        vector<Event> list=matching(keyword);
+        if (list.empty() && fmt==OutputFormat::Table){ out()<<"No matches.\n"; return; }
+        printEvents(list,fmt);
+    }
+
+    // Machine formats: "section,key,count" rows (total, type, top_date) for
+    // CSV/TSV, one {"total","byType","topDates"} object for JSON.
+    void statistics(OutputFormat fmt=OutputFormat::Table){
+        OpTimer timed(OpStatistics);
+        map<string,int> byType, byDate; for (const auto& e: events){ byType[e.type]++; byDate[e.date]++; }
+        vector<pair<string,int>> v(byDate.begin(),byDate.end());
+        sort(v.begin(),v.end(),[](auto&a,auto&b){return a.second>b.second;});
+        if (v.size()>5) v.resize(5);
+        if (fmt==OutputFormat::Table){
+            out()<<"Total events: "<<events.size()<<"\n";
+            out()<<"By type:\n"; for (auto&p: byType) out()<<"  "<<p.first<<": "<<p.second<<"\n";
+            out()<<"Top 5 dates by count:\n"; for (auto&p: v) out()<<"  "<<p.first<<": "<<p.second<<"\n";
+            return;
+        }
+        OutBuf ob(out());
+        if (fmt==OutputFormat::Json){
+            ob.put("{\"total\":"); ob.number((long long)events.size(),0); ob.put(",\"byType\":{");
+            bool first=true;
+            for (auto& p: byType){ if (!first) ob.put(","); first=false; ob.json(p.first); ob.put(":"); ob.number(p.second,0); }
+            ob.put("},\"topDates\":[");
+            for (size_t i=0;i<v.size();i++){ ob.put(i ? ",{\"date\":" : "{\"date\":"); ob.json(v[i].first); ob.put(",\"count\":"); ob.number(v[i].second,0); ob.put("}"); }
+            ob.put("]}"); ob.endRow();
+            return;
+        }
+        const char* sep = fmt==OutputFormat::Tsv ? "\t" : ",";
+        auto row=[&](const char* section, const string& key, long long n){
+            ob.put(section); ob.put(sep);
+            if (fmt==OutputFormat::Tsv) ob.tsv(key); else ob.csv(key);
+            ob.put(sep); ob.number(n,0); ob.endRow();
+        };
+        ob.put("section"); ob.put(sep); ob.put("key"); ob.put(sep); ob.put("count"); ob.endRow();
+        row("total","",(long long)events.size());
+        for (auto& p: byType) row("type",p.first,p.second);
+        for (auto& p: v) row("top_date",p.first,p.second);
+    }
+
+    // ------------------- Reminders -------------------
+    // Streams the paste line by line through EmailScanner; domains are
+    // lower-cased so the same mailbox pasted twice compares equal.
+    static vector<string> pasteEmails(){
+        out()<<"Paste emails (comma/semicolon/space/newline separated, \"Name <addr>\" ok). End with a blank line.\n";
+        EmailScanner scanner; vector<string> emails; string line;
+        while (getline(cin,line) && !line.empty())
+            scanner.scan(line,[&](string_view a){
+                emails.emplace_back(a); string& e=emails.back();
+                for (size_t k=e.rfind('@')+1; k<e.size(); k++) e[k]=(char)tolower((unsigned char)e[k]);
+            });
+        if (size_t bad=scanner.rejectedTotal()){
+            out()<<"Rejected "<<bad<<" entr"<<(bad==1?"y":"ies")<<":";
+            for (int r=0; r<EmailScanner::kReasons; r++) if (scanner.rejected[r]) out()<<" "<<EmailScanner::reasonName(r)<<" "<<scanner.rejected[r]<<";";
+            out()<<"\n";
+        }
+        return emails;
+    }
+
+    void loadAttendeesFromPaste(){
+        attendeeEmails = pasteEmails();
+        attendeeBytes=0; for (const auto& a: attendeeEmails) attendeeBytes += sizeof(string)+heapBytes(a);
+        out()<<"Loaded "<<attendeeEmails.size()<<" attendee emails.\n";
+    }
+
+    // Register emails for one event (duplicates ignored). Only the batch is
+    // sorted; what's new is inserted at the end of the event's range and
+    // merged with it, and only the new rows are measured.
+    size_t registerAttendees(int eventId, const vector<string>& emails){
+        OpTimer timed(OpRegister);
+        if (!posById.count(eventId)) return 0;
+        vector<string> batch(emails); sort(batch.begin(),batch.end()); batch.erase(unique(batch.begin(),batch.end()),batch.end());
+        auto lo = lower_bound(registrations.begin(),registrations.end(),make_pair(eventId,string()));
+        auto hi = lo; while (hi!=registrations.end() && hi->first==eventId) ++hi;
+        vector<pair<int,string>> fresh; auto r=lo;
+        for (auto& a: batch){
+            while (r!=hi && r->second<a) ++r;
+            if (r==hi || r->second!=a){ registrationBytes += sizeof(pair<int,string>)+heapBytes(a); fresh.push_back({eventId,move(a)}); }
+        }
+        if (fresh.empty()) return 0;
+        size_t from=lo-registrations.begin(), mid=hi-registrations.begin();
+        registrations.insert(hi,make_move_iterator(fresh.begin()),make_move_iterator(fresh.end()));
+        inplace_merge(registrations.begin()+from,registrations.begin()+mid,registrations.begin()+mid+fresh.size());
+        return fresh.size();
+    }
+
+    void registerAttendeesFromPaste(int eventId){
+        if (!posById.count(eventId)){ out()<<"Event not found.\n"; return; }
+        size_t added = registerAttendees(eventId,pasteEmails());
+        out()<<"Registered "<<added<<" new attendees for event "<<eventId<<".\n";
+    }
+
+    size_t registrationCount() const { return registrations.size(); }
+
+    // Digest reminders for [fromDate, toDate]: every recipient gets one
+    // message listing all of their events in the window. Window events come
+    // from the day index in chronological order; they are merge-joined (by
+    // id) with the sorted registrations, and the (recipient, event) pairs are
+    // then grouped per recipient. Loaded attendees count as registered for
+    // every event. Recipients whose digests are identical share one send.
+    // Returns the number of distinct messages queued.
+    size_t sendDigestForRange(const string& fromDate, const string& toDate, ReminderPipeline& pipeline){
+        OpTimer timed(OpDigest);
+        vector<size_t> window;                        // positions, chronological
+        for (auto it=dayIndex.lower_bound(dayKey(fromDate)); it!=dayIndex.end() && it->first<=dayKey(toDate); ++it)
+            window.insert(window.end(),it->second.begin(),it->second.end());
+        if (window.empty()){ out()<<"No events in this range.\n"; return 0; }
+
+        vector<pair<int,uint32_t>> byId;              // (event id, chronological rank)
+        for (uint32_t r=0; r<window.size(); r++) byId.push_back({events[window[r]].id,r});
+        sort(byId.begin(),byId.end());
+
+        vector<pair<const string*,uint32_t>> pairs;   // (recipient, rank)
+        auto reg=registrations.begin();
+        for (const auto& w: byId){
+            while (reg!=registrations.end() && reg->first<w.first) ++reg;
+            for (auto r=reg; r!=registrations.end() && r->first==w.first; ++r) pairs.push_back({&r->second,w.second});
+        }
+        sort(pairs.begin(),pairs.end(),[](const pair<const string*,uint32_t>& a, const pair<const string*,uint32_t>& b){
+            int c=a.first->compare(*b.first); return c!=0 ? c<0 : a.second<b.second; });
+
+        // Group recipients by their digest content (the list of ranks).
+        map<vector<uint32_t>,vector<string>> digests;
+        vector<uint32_t> all(window.size()); for (uint32_t r=0;r<all.size();r++) all[r]=r;
+        set<string> personal;
+        for (size_t i=0;i<pairs.size(); ){
+            size_t j=i; vector<uint32_t> ranks;
+            while (j<pairs.size() && *pairs[j].first==*pairs[i].first){ if (ranks.empty() || ranks.back()!=pairs[j].second) ranks.push_back(pairs[j].second); j++; }
+            if (!attendeeEmails.empty()) ranks=all;   // also on the global list
+            digests[ranks].push_back(*pairs[i].first); personal.insert(*pairs[i].first);
+            i=j;
+        }
+        for (const auto& a: attendeeEmails) if (!personal.count(a)) digests[all].push_back(a);
+        if (digests.empty()){ out()<<"Nobody is registered for events in this range.\n"; return 0; }
+
+        string label = fromDate==toDate ? "on "+fromDate : fromDate+" to "+toDate;
+        size_t recipients=0;
+        for (const auto& d: digests){
+            vector<Event> list; for (uint32_t r: d.first) list.push_back(events[window[r]]);
+            queueReminder(digestTemplate,label,move(list),d.second,pipeline);
+            recipients += d.second.size();
+        }
+        out()<<"Queued "<<digests.size()<<" distinct digests for "<<recipients<<" recipients ("<<pairs.size()+(attendeeEmails.size()*window.size())<<" event notices folded).\n";
+        return digests.size();
+    }
+
+    // Renders the reminder once and hands it to the delivery pipeline; the
+    // command returns as soon as the batches are queued.
+    void sendReminderForDate(const string& date, ReminderPipeline& pipeline){
+        OpTimer timed(OpRemind);
+        vector<Event> list=onDate(date);
+        if (list.empty()){ out()<<"No events on this date.\n"; return; }
+        if (attendeeEmails.empty()){
+            out()<<"No attendee emails loaded. Choose 'Load attendees' first.\n"; return;
+        }
+        string subject, body;      // preview, as the first recipient sees it
+        reminderTemplate.render(date,list,&attendeeEmails.front(),subject,body);
+        int group = queueReminder(reminderTemplate,date,move(list),attendeeEmails,pipeline);
+        out()<<"Queued reminder #"<<group<<" to "<<attendeeEmails.size()<<" recipients via "<<pipeline.transportName()<<".\nSubject: "<<subject<<"\n\n"<<body;
+        out()<<"(Delivery continues in the background; see 'Reminder delivery status'.)\n";
+    }
+
+    // Shared content is rendered once here; personalized templates are
+    // rendered on the delivery workers from a snapshot of the template and
+    // the events, into buffers the transport reuses per recipient.
+    static int queueReminder(const ReminderTemplate& tmpl, const string& date, vector<Event> list, const vector<string>& rcpts, ReminderPipeline& pipeline){
+        if (!tmpl.personalized()){
+            string subject, body; tmpl.render(date,list,nullptr,subject,body);
+            return pipeline.submit(subject,body,rcpts);
+        }
+        string recipe = renderRecipe(tmpl,date,list);
+        auto snap = make_shared<const tuple<ReminderTemplate,string,vector<Event>>>(tmpl,date,move(list));
+        string label="(personalized) "; tmpl.subject.render({date,get<2>(*snap),nullptr,tmpl.unsubscribeBase},label);
+        return pipeline.submitPersonalized(label,rcpts,snapshotRender(snap),recipe);
+    }
+
+    static MailTransport::Render snapshotRender(shared_ptr<const tuple<ReminderTemplate,string,vector<Event>>> snap){
+        return [snap](const string& rcpt, string& subject, string& body){ get<0>(*snap).render(get<1>(*snap),get<2>(*snap),&rcpt,subject,body); };
+    }
+
+    // A personalized send is journaled as its inputs (template sources, date
+    // label, encoded events) so the outbox can rebuild the renderer.
+    static string renderRecipe(const ReminderTemplate& tmpl, const string& date, const vector<Event>& list){
+        string r = escapeField(tmpl.subject.source())+'\t'+escapeField(tmpl.body.source())+'\t'+escapeField(tmpl.unsubscribeBase)+'\t'+escapeField(date);
+        for (const auto& e: list) r += '\t'+escapeField(encodeMutation({Mutation::Put,0,e}));
+        return r;
+    }
+
+    static MailTransport::Render reviveRender(const string& recipe){
+        vector<string> f=splitEscaped(recipe); if (f.size()<4) return nullptr;
+        ReminderTemplate tmpl=ReminderTemplate::classic(); string err;
+        if (!tmpl.subject.compile(f[0],err) || !tmpl.body.compile(f[1],err)) return nullptr;
+        tmpl.unsubscribeBase=f[2];
+        vector<Event> list;
+        for (size_t i=4;i<f.size();i++){ Mutation m; if (!decodeMutation(f[i],m)) return nullptr; list.push_back(m.e); }
+        return snapshotRender(make_shared<const tuple<ReminderTemplate,string,vector<Event>>>(move(tmpl),f[3],move(list)));
+    }
+
+    // which: 0 = per-date reminder, 1 = digest.
+    ReminderTemplate& messageTemplate(int which){ return which ? digestTemplate : reminderTemplate; }
+
+    bool setMessageTemplate(int which, const string& subjectText, const string& bodyText, string& err){
+        ReminderTemplate t = messageTemplate(which);
+        if (!compileTemplate(t,subjectText,bodyText,err)) return false;
+        messageTemplate(which) = move(t);
+        return true;
+    }
+
+    // Compiles into t; t is unchanged on error.
+    static bool compileTemplate(ReminderTemplate& t, const string& subjectText, const string& bodyText, string& err){
+        ReminderTemplate next = t;
+        if (!next.subject.compile(subjectText,err)){ err="subject: "+err; return false; }
+        if (!next.body.compile(bodyText,err)){ err="body: "+err; return false; }
+        t = move(next);
+        return true;
+    }
+
+    // ------------------- Suggestions -------------------
+    void suggestSlots(const string& date, int duration=60){
+        OpTimer timed(OpSuggest);
+        out()<<"Suggested available slots on "<<date<<":\n";
+        vector<pair<int,int>> occ; for (size_t p: slotsOn(date)){ int s=toMinutes(events[p].time); occ.push_back({s,s+60}); }
+        int start=8*60, end=20*60, shown=0;
+        for (int t=start; t+duration<=end && shown<5; t+=30){ bool clash=false; for (auto& iv: occ){ if (!(t+duration<=iv.first || t>=iv.second)) { clash=true; break; } } if(!clash){ out()<<"  - "<<fromMinutes(t)<<" to "<<fromMinutes(t+duration)<<"\n"; shown++; } }
+        if (!shown) out()<<"  (No free 1-hour slots found in working window)\n";
+    }
+
+    // ------------------- Snapshot (manual persistence aid) -------------------
+    // Table (the default) is the text the import option reads back; the
+    // machine formats write every event like LIST does, without the hint.
+    // Rows follow the day index in both, so a delete doesn't reorder them.
+    void exportSnapshotCSV(OutputFormat fmt=OutputFormat::Table){
+        OpTimer timed(OpExport);
+        if (fmt!=OutputFormat::Table){ OutBuf ob(out()); EventWriter w(ob,fmt); for (const auto& d: dayIndex) for (size_t p: d.second) w.row(events[p]); return; }
+        out()<<"id,name,date,time,type,location\n";
+        for (const auto& d: dayIndex) for (size_t p: d.second){
+            const Event& e=events[p];
+            out()<<e.id<<","<<e.name<<","<<e.date<<","<<e.time<<","<<e.type<<","<<e.location<<"\n";
+        }
+        out()<<"(Copy the above lines to save. Import with the menu option.)\n";
+    }
+
+    void importSnapshotCSV(){
+        TRACE_SPAN("importCSV");
+        out()<<"Paste CSV lines (header optional). End with a blank line.\n";
+        string line; vector<Event> temp; int maxId=0; bool first=true;
+        {
+            TRACE_SPAN("import.parse");
+            while (true){
+                getline(cin,line); if (line.size()==0) break; if (line.find(",")==string::npos) continue;
+                if (first && toLower(line).find("id,name,date,time,type,location")!=string::npos){ first=false; continue; }
+                first=false;
+                stringstream ss(line); string tok; Event e; int col=0;
+                while (getline(ss,tok,',')){
+                    switch(col){
+                        case 0: if (!tok.empty()) e.id = stoi(tok); break;
+                        case 1: e.name = tok; break;
+                        case 2: e.date = tok; break;
+                        case 3: e.time = tok; break;
+                        case 4: e.type = tok; break;
+                        case 5: e.location = tok; break;
+                    }
+                    col++;
+                }
+                temp.push_back(move(e));
+            }
+        }
+        {
+            TRACE_SPAN("import.validate");
+            temp.erase(remove_if(temp.begin(),temp.end(),[](const Event& e){ return e.id==0 || e.name.empty() || !isValidDate(e.date) || !isValidTime(e.time); }),temp.end());
+            for (const auto& e: temp) maxId=max(maxId,e.id);
+        }
+        if (temp.empty()){ out()<<"Nothing imported.\n"; return; }
+        temp.swap(events); nextId = maxId+1; reindex(); truncateLog();
+        if (!subs.empty() || !reminderOffsets.empty()){ TRACE_SPAN("import.notify"); for (const auto& e: temp) notify(&e,nullptr); for (const auto& e: events) notify(nullptr,&e); }
+        out()<<"Imported "<<events.size()<<" events. Next ID: "<<nextId<<"\n";
+    }
+
+    // ------------------- Replication (log shipping) -------------------
+    // Records travel as single text lines (escapeField/splitEscaped) so the
+    // same stream could be written to a pipe or socket.
+    static string encodeMutation(const Mutation& m){
+        const auto& esc=escapeField;
+        ostringstream os;
+        os<<m.lsn<<'\t'<<(m.op==Mutation::Put?'P':'E')<<'\t'<<m.e.id;
+        if (m.op==Mutation::Put) os<<'\t'<<esc(m.e.name)<<'\t'<<m.e.date<<'\t'<<m.e.time<<'\t'<<esc(m.e.type)<<'\t'<<esc(m.e.location);
+        return os.str();
+    }
+
+    static bool decodeMutation(const string& line, Mutation& m){
+        vector<string> f=splitEscaped(line);
+        if (f.size()<3 || (f[1]!="P" && f[1]!="E")) return false;
+        try { m.lsn=stoll(f[0]); m.e=Event{}; m.e.id=stoi(f[2]); } catch (...) { return false; }
+        m.op = f[1]=="P" ? Mutation::Put : Mutation::Erase;
+        if (m.op==Mutation::Put){
+            if (f.size()!=8) return false;
+            m.e.name=f[3]; m.e.date=f[4]; m.e.time=f[5]; m.e.type=f[6]; m.e.location=f[7];
+        }
+        return true;
+    }
+
+    uint64_t uid() const { return id; }
+    long long currentLsn() const { return lastLsn; }
+    size_t logSize() const { return mlog.size(); }
+
+    // Append encoded records with LSN > fromLsn (at most maxRecords). Returns
+    // false when fromLsn predates the retained log: caller needs a checkpoint.
+    bool shipLog(long long fromLsn, size_t maxRecords, vector<string>& lines) const {
+        if (fromLsn<logStart) return false;
+        size_t skip = (size_t)(fromLsn-logStart);
+        for (size_t i=skip; i<mlog.size() && maxRecords>0; i++, maxRecords--) lines.push_back(encodeMutation(mlog[i]));
+        return true;
+    }
+
+    void checkpoint(vector<Event>& rows, int& next, long long& lsn) const { rows=events; next=nextId; lsn=lastLsn; }
+
+    // Follower side: install a checkpoint / apply one shipped record. No
+    // validation here, the leader already accepted the change.
+    void restoreCheckpoint(const vector<Event>& rows, int next){ events=rows; nextId=next; reindex(); mlog.clear(); logBytes=0; logStart=lastLsn=0; rescheduleAll(scheduler.now()); }
+
+    // ------------------- Automatic reminders -------------------
+    // Rebuilds the timer wheel; reminders due after sinceMinute (and not yet
+    // fired) fire on the next fireDueReminders().
+    void rescheduleAll(long long sinceMinute){
+        TRACE_SPAN("reminders.reschedule");
+        scheduler.reset(sinceMinute);
+        if (!reminderOffsets.empty()) for (const auto& e: events) scheduler.schedule(e.id,startMinute(e),reminderOffsets);
+    }
+
+    void setReminderOffsets(const vector<int>& minutesBefore, long long sinceMinute){ reminderOffsets=minutesBefore; rescheduleAll(sinceMinute); }
+    const vector<int>& reminderSchedule() const { return reminderOffsets; }
+    size_t pendingReminders() const { return scheduler.pending(); }
+    size_t unsentReminders() const { return unsent; }
+    size_t attendeeCount() const { return attendeeEmails.size(); }
+    long long nextReminderDue() const { return scheduler.nextDue(); }
+    long long reminderClock() const { return scheduler.now(); }
+
+    // Fire everything due by nowMinute: one message per (event, offset) to the
+    // loaded attendees. With none loaded they can't be sent, and a timer left
+    // behind by a clock catching up may belong to an event that has already
+    // started; both are counted in unsentReminders() rather than sent late.
+    // Returns the number of reminders fired.
+    size_t fireDueReminders(long long nowMinute, ReminderPipeline& pipeline){
+        vector<ReminderScheduler::Due> due; scheduler.advance(nowMinute,due);
+        if (attendeeEmails.empty()){ unsent += due.size(); return due.size(); }
+        for (const auto& d: due){
+            const Event* found = findById(d.eventId); if (!found) continue;
+            const Event& e = *found; int off = d.offsetMin;
+            if (startMinute(e)<=nowMinute){ unsent++; continue; }
+            string when = off%60==0 ? to_string(off/60)+"h" : to_string(off)+"min";
+            string body = "Starting in "+when+":\n\n- "+e.date+" "+e.time+" | "+e.name+" ("+e.type+") @ "+(e.location.empty()?"TBA":e.location)+"\n";
+            // Keyed on content and fire time: a timer that fires again
+            // after a restart doesn't remind anyone twice.
+            string subject = "Reminder: "+e.name+" starts in "+when;
+            string key = "auto-"+to_string(startMinute(e)-off)+"-"+to_string(fnv1a(subject+body));
+            pipeline.submit(subject,body,attendeeEmails,key);
+        }
+        return due.size();
+    }
+
+    // ------------------- Memory accounting / spill -------------------
+    // Approximate bytes owned by this calendar: event rows + strings, day
+    // index (map nodes + position vectors), mutation log, attendees, watches.
+    // memoryBytes() is the sum of the parts, so quota checks and reports agree.
+    static const int kMemoryParts = 10;
+    array<MemoryPart,kMemoryParts> memoryBreakdown() const {
+        const size_t kMapNode = 48+sizeof(pair<const int,vector<size_t>>);
+        return {{
+            {"event records", events.capacity()*sizeof(Event)},
+            {"event strings", storeBytes-events.size()*sizeof(Event)},
+            {"indexes", dayIndex.size()*kMapNode + events.size()*sizeof(size_t)
+                        + posById.size()*(sizeof(pair<const int,size_t>)+16) + posById.bucket_count()*sizeof(void*)},
+            {"mutation log", logBytes},
+            {"attendee emails", attendeeBytes},
+            {"registrations", registrationBytes},
+            {"reminder timers", scheduler.memoryBytes()},
+            {"subscriptions", subs.size()*sizeof(Subscription)},
+            {"templates", reminderTemplate.heapBytes()+digestTemplate.heapBytes()},
+            {"manager", sizeof(*this)},
+        }};
+    }
+
+    size_t memoryBytes() const { size_t n=0; for (const auto& p: memoryBreakdown()) n+=p.bytes; return n; }
+
+    void setQuota(size_t bytes){ quotaBytes=bytes; }
+    size_t quota() const { return quotaBytes; }
+
+    // Spill format: "EVTSNAP 1 <nextId>", then one encoded Put record per
+    // event and one "@<email>" line per attendee.
+    bool saveTo(ostream& os) const {
+        OpTimer timed(OpSave);
+        os<<"EVTSNAP 1 "<<nextId<<"\n";
+        for (const auto& e: events) os<<encodeMutation({Mutation::Put,0,e})<<"\n";
+        for (const auto& a: attendeeEmails) os<<'@'<<a<<"\n";
+        for (const auto& r: registrations) os<<'R'<<r.first<<'\t'<<r.second<<"\n";
+        for (int which=0; which<2; which++){
+            const ReminderTemplate& t = which ? digestTemplate : reminderTemplate;
+            os<<'T'<<which<<'\t'<<escapeField(t.subject.source())<<'\t'<<escapeField(t.body.source())<<'\t'<<escapeField(t.unsubscribeBase)<<"\n";
+        }
+        return (bool)os;
+    }
+
+    bool loadFrom(istream& is){
+        OpTimer timed(OpLoad);
+        string line; int next=1;
+        if (!getline(is,line) || line.compare(0,10,"EVTSNAP 1 ")!=0) return false;
+        try { next=stoi(line.substr(10)); } catch (...) { return false; }
+        vector<Event> rows; vector<string> emails; vector<pair<int,string>> regs;
+        ReminderTemplate templates[2] = {reminderTemplate, digestTemplate};
+        {
+            TRACE_SPAN("snapshot.parse");
+            while (getline(is,line)){
+                if (!line.empty() && line[0]=='@'){ emails.push_back(line.substr(1)); continue; }
+                if (!line.empty() && line[0]=='R'){
+                    size_t tab=line.find('\t'); if (tab==string::npos) return false;
+                    try { regs.push_back({stoi(line.substr(1,tab-1)),line.substr(tab+1)}); } catch (...) { return false; }
+                    continue;
+                }
+                if (line.size()>2 && line[0]=='T'){
+                    vector<string> f=splitEscaped(line.substr(1)); string err;
+                    if (f.size()!=4 || (f[0]!="0" && f[0]!="1") || !compileTemplate(templates[f[0]=="1"],f[1],f[2],err)) return false;
+                    templates[f[0]=="1"].unsubscribeBase=f[3];
+                    continue;
+                }
+                Mutation m; if (!decodeMutation(line,m)) return false;
+                rows.push_back(m.e);
+            }
+        }
+        restoreCheckpoint(rows,next);
+        reminderTemplate=move(templates[0]); digestTemplate=move(templates[1]);
+        attendeeEmails.swap(emails);
+        attendeeBytes=0; for (const auto& a: attendeeEmails) attendeeBytes += sizeof(string)+heapBytes(a);
+        registrations.swap(regs);
+        registrationBytes=0; for (const auto& r: registrations) registrationBytes += sizeof(pair<int,string>)+heapBytes(r.second);
+        return true;
+    }
+
+    // Followers notify their own subscribers but never append to a log.
+    void applyMutation(const Mutation& m){
+        auto it = posById.find(m.e.id);
+        if (m.op==Mutation::Erase){ if (it!=posById.end()){ size_t pos=it->second; Event old=events[pos]; eraseAt(pos); notify(&old,nullptr); } return; }
+        if (it!=posById.end()){ size_t pos=it->second; Event old=events[pos]; storeBytes -= eventBytes(old); indexRemove(pos,old.date); events[pos]=m.e; storeBytes += eventBytes(m.e); indexInsert(pos); notify(&old,&events[pos]); }
+        else { events.push_back(m.e); storeBytes += eventBytes(m.e); posById[m.e.id]=events.size()-1; indexInsert(events.size()-1); notify(nullptr,&events.back()); }
+        nextId = max(nextId, m.e.id+1);
+    }
+};
+
+// Viewer reads, shared by the server's read lane and the read-replica
+// process. False when cmd isn't one of them.
+bool runViewerRead(EventManager& m, const string& cmd, const string& arg, OutputFormat fmt){
+    if (cmd=="LIST") m.listAll(fmt);
+    else if (cmd=="DAY"){ if (EventManager::isValidDate(arg)) m.dayView(arg,fmt); else out()<<"Invalid date.\n"; }
+    else if (cmd=="TODAY") m.todaysEvents(fmt);
+    else if (cmd=="WEEK"){ if (EventManager::isValidDate(arg)) m.weekView(arg,fmt); else out()<<"Invalid date.\n"; }
+    else if (cmd=="MONTH"){ int mo,y; if (EventManager::parseMonth(arg,mo,y)) m.monthView(mo,y,fmt); else out()<<"Invalid month.\n"; }
+    else if (cmd=="SEARCH") m.search(arg,fmt);
+    else return false;
+    return true;
+}
+
+// A viewer read as sent to a child process: "[format=F ]CMD [ARG]".
+void runViewerRequest(EventManager& m, string req){
+    OutputFormat fmt=OutputFormat::Table;
+    if (req.compare(0,7,"format=")==0){ size_t sp=req.find(' '); parseOutputFormat(req.substr(7,sp==string::npos ? string::npos : sp-7),fmt); req = sp==string::npos ? "" : req.substr(sp+1); }
+    size_t sp=req.find(' ');
+    if (!runViewerRead(m,req.substr(0,sp),sp==string::npos ? "" : req.substr(sp+1),fmt)) out()<<"Not a viewer read.\n";
+}
+
+// ------------------- Child processes -------------------
+// This binary re-run as `--follow <role>`, joined to the parent by a
+// socketpair on its stdin/stdout. Requests are lines; replies are framed
+// "<bytes>\n<body>". Followers and cluster workers are both one of these.
+// Without fork (Windows) nothing starts and running() stays false.
+class ChildLink {
+protected:
+    const char* role;
+    int fd = -1, pid = -1; string rbuf;
+
+    bool send(const string& s){
+#ifndef _WIN32
+        for (size_t off=0; fd>=0 && off<s.size(); ){ ssize_t n=::send(fd,s.data()+off,s.size()-off,MSG_NOSIGNAL); if (n<=0){ disconnect(); break; } off+=(size_t)n; }
+#endif
+        return fd>=0;
+    }
+
+    bool fill(size_t want){
+#ifndef _WIN32
+        while (fd>=0 && rbuf.size()<want){
+            char buf[65536]; ssize_t n=recv(fd,buf,sizeof buf,0);
+            if (n<=0){ disconnect(); break; }
+            rbuf.append(buf,(size_t)n);
+        }
+#endif
+        return rbuf.size()>=want;
+    }
+
+    void disconnect(){
+#ifndef _WIN32
+        if (fd>=0) close(fd);
+        if (pid>0) waitpid(pid,nullptr,0);
+#endif
+        fd=pid=-1; rbuf.clear();
+    }
+
+    // One framed reply; false (and disconnected) if the child went away.
+    bool reply(string& body){
+        size_t nl;
+        while ((nl=rbuf.find('\n'))==string::npos) if (!fill(rbuf.size()+1)) return false;
+        size_t len=0; try { len=stoul(rbuf.substr(0,nl)); } catch (...) { disconnect(); return false; }
+        rbuf.erase(0,nl+1);
+        if (!fill(len)) return false;
+        body=rbuf.substr(0,len); rbuf.erase(0,len);
+        return true;
+    }
+
+public:
+    explicit ChildLink(const char* roleName): role(roleName) {}
+    ChildLink(const ChildLink&) = delete;
+    ChildLink& operator=(const ChildLink&) = delete;
+    ~ChildLink(){ stop(); }
+
+    // Call before any thread is started: the child only execs.
+    bool start(const char* self){
+#ifndef _WIN32
+        int sv[2]; if (socketpair(AF_UNIX,SOCK_STREAM|SOCK_CLOEXEC,0,sv)!=0) return false;
+        pid_t p=fork();
+        if (p<0){ close(sv[0]); close(sv[1]); return false; }
+        if (p==0){
+            setpgid(0,0);                // Ctrl-C at the prompt must not stop the child
+            dup2(sv[1],0); dup2(sv[1],1);
+            execl("/proc/self/exe",self,"--follow",role,(char*)nullptr);
+            execlp(self,self,"--follow",role,(char*)nullptr);
+            _exit(127);
+        }
+        close(sv[1]); fd=sv[0]; pid=p;
+        return true;
+#else
+        (void)self; return false;
+#endif
+    }
+
+    void stop(){ if (fd>=0) send("BYE\n"); disconnect(); }
+
+    bool running() const { return fd>=0; }
+    int processId() const { return pid; }
+};
+
+// ------------------- Replication (follower processes) -------------------
+// A follower runs as `--follow standby|replica`. The leader sends lines:
+//   C <org>      checkpoint: a spill snapshot follows, ended by "."
+//   M <record>   one encoded mutation
+//   Q <request>  (replica) a viewer read, answered "<bytes>\n<body>"
+//   BYE          clean shutdown
+// The standby is caught up after every command; if the leader goes away
+// without BYE it writes its copy to the calendar's spill file, which the
+// next start loads. The replica is caught up only once it is more than
+// maxLag operations behind, so viewer reads are bounded-stale. Attendees,
+// registrations and templates aren't in the log: resync() after changing
+// them ships a fresh checkpoint. If no follower could start, reads stay on
+// the leader.
+class Follower : public ChildLink {
+    uint64_t source = 0;             // uid of the leader we follow
+    long long applied = 0, maxLag;   // last LSN shipped
+    int checkpoints = 0;
+
+public:
+    Follower(const char* roleName, long long maxLagOps=0): ChildLink(roleName), maxLag(maxLagOps) {}
+
+    bool following(const EventManager& leader) const { return running() && source==leader.uid(); }
+    long long lag(const EventManager& leader) const { return following(leader) ? leader.currentLsn()-applied : LLONG_MAX; }
+    long long shippedLsn() const { return applied; }
+    int checkpointCount() const { return checkpoints; }
+    void resync(){ source=0; }
+
+    // Returns number of log records shipped (checkpoints not counted).
+    size_t catchUp(const EventManager& leader, const string& org){
+        size_t n=0; vector<string> batch;
+        while (running()){
+            batch.clear();
+            if (source!=leader.uid() || !leader.shipLog(applied,4096,batch)){
+                ostringstream snap; snap<<"C "<<org<<"\n"; leader.saveTo(snap); snap<<".\n";
+                if (!send(snap.str())) break;
+                applied=leader.currentLsn(); source=leader.uid(); checkpoints++; continue;
+            }
+            if (batch.empty()) break;
+            string msg; for (const auto& line: batch){ msg+="M "; msg+=line; msg+='\n'; }
+            if (!send(msg)) break;
+            applied += (long long)batch.size(); n += batch.size();    // shipped LSNs are consecutive
+        }
+        return n;
+    }
+
+    // A viewer read answered by the replica; false if it isn't running
+    // (the caller reads the leader instead).
+    bool query(const EventManager& leader, const string& org, const string& request, string& body){
+        if (lag(leader)>maxLag) catchUp(leader,org);
+        return send("Q "+request+"\n") && reply(body);
+    }
+};
+
+// ------------------- Cluster (hash-partitioned worker processes) -------------------
+// --cluster N spreads calendars over N worker processes (`--follow worker`).
+// Events are placed by consistent hashing on (tenant, day) with 64 virtual
+// nodes per worker, so a day's duplicate and conflict checks stay on one
+// worker: ADD, DAY and TODAY go only to the owner. LIST and SEARCH go to
+// every worker at once and the sorted partial results are k-way merged;
+// WEEK and MONTH gather their days the same way and render them locally.
+// ADDWORKER starts one more worker and moves it only the (tenant, day)
+// groups it now owns. Ids are handed out by the router (one sequence per
+// tenant), so they are unique across workers; rows a worker rejects from a
+// bulk add leave gaps. Worker requests are escaped tab-separated fields:
+//   A org id name date time type location   checked add: "1"/"0" line, message
+//   B org n  (n "id name date ..." rows)    checked bulk add: number added
+//   P org n  (n encoded records)            install moved rows unchecked
+//   Q org request                           viewer read, as for the replica
+//   L org | S org keyword | R org from to   rows: by time | by id | day range
+//   E org id | X org name                   delete: number removed
+//   K                                       "org date count" per day held
+//   T org date...                           remove and return those days
+//   N                                       "tenants events"
+// Workers keep their share only while the router runs; if one dies, the
+// requests that need it answer ERR.
+class ClusterWorker : public ChildLink {
+public:
+    ClusterWorker(): ChildLink("worker") {}
+    bool post(const string& request){ return send(request); }
+    bool collect(string& body){ return reply(body); }
+    bool call(const string& request, string& body){ return post(request) && collect(body); }
+};
+
+class Cluster {
+    const char* self;
+    vector<unique_ptr<ClusterWorker>> workers;
+    map<uint64_t,int> ring;          // virtual node hash -> worker index
+    map<string,int> nextId;          // per tenant, as in a single EventManager
+    static const int kVnodes = 64;
+
+    static string request(initializer_list<string> fields){
+        string r; for (const auto& f: fields){ if (!r.empty()) r+='\t'; r+=escapeField(f); }
+        return r+'\n';
+    }
+
+    static vector<Event> rows(const string& body){
+        vector<Event> list; istringstream is(body); string line; Mutation m;
+        while (getline(is,line)) if (EventManager::decodeMutation(line,m)) list.push_back(m.e);
+        return list;
+    }
+
+    // FNV-1a of near-identical keys ("worker-0#1", "worker-0#2") differs
+    // mostly in the low bits; a finalizer spreads them around the ring.
+    static uint64_t place(const string& key){
+        uint64_t h=fnv1a(key);
+        h^=h>>33; h*=0xff51afd7ed558ccdULL; h^=h>>33; h*=0xc4ceb9fe1a85ec53ULL; h^=h>>33;
+        return h;
+    }
+
+    int ownerOf(const string& tenant, const string& date) const {
+        auto it = ring.lower_bound(place(tenant+'\t'+date));
+        return it==ring.end() ? ring.begin()->second : it->second;
+    }
+
+    // Post to every worker, then collect: the workers run in parallel.
+    // False if any of them is down.
+    bool scatter(const string& req, vector<string>& bodies){
+        bodies.assign(workers.size(),string());
+        for (auto& w: workers) w->post(req);
+        bool ok=true;
+        for (size_t i=0;i<workers.size();i++) ok = workers[i]->collect(bodies[i]) && ok;
+        return ok;
+    }
+
+    // Merge per-worker sorted runs with a min-heap: O(n log k).
+    template<class Less> static vector<Event> kwayMerge(const vector<vector<Event>>& runs, Less less){
+        using Cur = pair<size_t,size_t>;   // (run, position)
+        auto cmp=[&](const Cur& a, const Cur& b){ return less(runs[b.first][b.second],runs[a.first][a.second]); };
+        priority_queue<Cur,vector<Cur>,decltype(cmp)> heap(cmp);
+        size_t total=0;
+        for (size_t r=0;r<runs.size();r++){ total+=runs[r].size(); if (!runs[r].empty()) heap.push({r,0}); }
+        vector<Event> merged; merged.reserve(total);
+        while (!heap.empty()){
+            Cur c=heap.top(); heap.pop(); merged.push_back(runs[c.first][c.second]);
+            if (c.second+1<runs[c.first].size()) heap.push({c.first,c.second+1});
+        }
+        return merged;
+    }
+
+    template<class Less> bool gather(const string& req, Less less, vector<Event>& merged){
+        vector<string> bodies; if (!scatter(req,bodies)) return false;
+        vector<vector<Event>> runs; for (const auto& b: bodies) runs.push_back(rows(b));
+        merged=kwayMerge(runs,less);
+        return true;
+    }
+
+    static size_t countOf(const string& body){ try { return stoul(body); } catch (...) { return 0; } }
+
+    bool handle(const string& org, const string& cmd, const string& arg, OutputFormat fmt, const vector<string>& payload, string& body){
+        const string view = fmt!=OutputFormat::Table ? "format="+string(formatName(fmt))+" " : "";
+        const string down = "A worker is down.\n";
+        ostringstream os;
+        int& next = nextId.emplace(org,1).first->second;
+        if (cmd=="ADD"){
+            auto f=splitFields(arg);
+            if (f.size()<4){ body="Expected name|date|time|type|location.\n"; return true; }
+            if (!EventManager::isValidDate(f[1])){ body="Invalid date. Use DD-MM-YYYY.\n"; return true; }
+            string reply;
+            if (!workers[ownerOf(org,f[1])]->call(request({"A",org,to_string(next),f[0],f[1],f[2],f[3],f.size()>4?f[4]:""}),reply)){ body=down; return false; }
+            if (reply.compare(0,2,"1\n")==0) next++;
+            body=reply.substr(min<size_t>(2,reply.size()));
+            return true;
+        }
+        if (cmd=="ADDMANY"){
+            vector<string> batch(workers.size()); vector<size_t> counts(workers.size(),0);
+            for (const auto& row: payload){
+                auto f=splitFields(row);
+                if (f.size()<4 || !EventManager::isValidDate(f[1])) continue;
+                int w=ownerOf(org,f[1]);
+                batch[w] += request({to_string(next++),f[0],f[1],f[2],f[3],f.size()>4?f[4]:""}); counts[w]++;
+            }
+            for (size_t w=0;w<workers.size();w++) if (counts[w]) workers[w]->post(request({"B",org,to_string(counts[w])})+batch[w]);
+            size_t added=0; bool ok=true; string reply;
+            for (size_t w=0;w<workers.size();w++) if (counts[w]){ ok = workers[w]->collect(reply) && ok; added += countOf(reply); }
+            body = "Added "+to_string(added)+" of "+to_string(payload.size())+" events.\n"+(ok ? "" : down);
+            return ok;
+        }
+        if (cmd=="DAY" || cmd=="TODAY"){
+            string date = cmd=="TODAY" ? EventManager::today() : arg;
+            if (!EventManager::isValidDate(date)){ body="Invalid date.\n"; return true; }
+            if (!workers[ownerOf(org,date)]->call(request({"Q",org,view+cmd+(cmd=="DAY" ? " "+arg : "")}),body)){ body=down; return false; }
+            return true;
+        }
+        if (cmd=="LIST" || cmd=="SEARCH"){
+            vector<Event> list;
+            bool ok = cmd=="LIST" ? gather(request({"L",org}),EventManager::chronoLess,list)
+                                  : gather(request({"S",org,arg}),[](const Event& a,const Event& b){ return a.id<b.id; },list);
+            if (!ok){ body=down; return false; }
+            ostream* saved=tlsOut; tlsOut=&os;
+            if (list.empty() && fmt==OutputFormat::Table) os<<(cmd=="LIST" ? "No events.\n" : "No matches.\n");
+            else EventManager::printEvents(list,fmt);
+            tlsOut=saved; body=os.str();
+            return true;
+        }
+        if (cmd=="WEEK" || cmd=="MONTH"){
+            long long from, to; int month, year;
+            if (cmd=="WEEK"){
+                if (!EventManager::isValidDate(arg)){ body="Invalid date.\n"; return true; }
+                int k=EventManager::dayKey(arg); long long z=EventManager::daysFromCivil(k/10000,k/100%100,k%100);
+                from=z-EventManager::weekdayMon0(z); to=from+6;
+            } else {
+                if (!EventManager::parseMonth(arg,month,year)){ body="Invalid month.\n"; return true; }
+                from=EventManager::daysFromCivil(year,month,1); to=EventManager::daysFromCivil(year+(month==12),month%12+1,1)-1;
+            }
+            vector<Event> list;
+            if (!gather(request({"R",org,to_string(EventManager::keyFromDays(from)),to_string(EventManager::keyFromDays(to))}),EventManager::chronoLess,list)){ body=down; return false; }
+            EventManager days; for (const auto& e: list) days.applyMutation({Mutation::Put,0,e});
+            ostream* saved=tlsOut; tlsOut=&os; runViewerRead(days,cmd,arg,fmt); tlsOut=saved;
+            body=os.str();
+            return true;
+        }
+        if (cmd=="DEL" || cmd=="DELNAME"){
+            if (cmd=="DEL" && (arg.empty() || arg.size()>9 || !all_of(arg.begin(),arg.end(),[](char c){ return isdigit((unsigned char)c); }))){ body="Invalid ID.\n"; return true; }
+            vector<string> bodies; bool ok=scatter(request({cmd=="DEL" ? "E" : "X",org,arg}),bodies);
+            size_t n=0; for (const auto& b: bodies) n+=countOf(b);
+            body = n ? "Deleted.\n" : cmd=="DEL" ? "No event with that ID.\n" : "No event with that name.\n";
+            if (!ok) body+=down;
+            return ok;
+        }
+        if (cmd=="WORKERS"){
+            vector<string> bodies; scatter(request({"N"}),bodies);
+            os<<workers.size()<<" workers, "<<kVnodes<<" virtual nodes each\n";
+            for (size_t i=0;i<workers.size();i++){
+                os<<"  worker "<<i<<": ";
+                if (!workers[i]->running()){ os<<"down\n"; continue; }
+                istringstream is(bodies[i]); size_t tenants=0, events=0; is>>tenants>>events;
+                os<<"pid "<<workers[i]->processId()<<", "<<tenants<<" tenants, "<<events<<" events\n";
+            }
+            body=os.str();
+            return true;
+        }
+        if (cmd=="ADDWORKER"){
+            size_t groups=0; long long moved=addWorker(groups);
+            if (moved<0){ body="Cannot start a worker.\n"; return false; }
+            os<<"Worker "<<workers.size()-1<<" started (pid "<<workers.back()->processId()<<"); moved "<<moved<<" events in "<<groups<<" day groups.\n";
+            body=os.str();
+            return true;
+        }
+        body="Not supported by the cluster router.\n";
+        return false;
+    }
+
+public:
+    explicit Cluster(const char* selfPath): self(selfPath) {}
+
+    size_t workerCount() const { return workers.size(); }
+
+    // Start one more worker and move it the (tenant, day) groups it now
+    // owns; groups that stay put aren't touched. Returns the number of
+    // events moved, or -1 if the worker can't start.
+    long long addWorker(size_t& groups){
+        auto fresh=make_unique<ClusterWorker>();
+        if (!fresh->start(self)) return -1;
+        vector<string> held; scatter(request({"K"}),held);
+        int idx=(int)workers.size();
+        workers.push_back(move(fresh));
+        for (int v=0; v<kVnodes; v++) ring[place("worker-"+to_string(idx)+"#"+to_string(v))]=idx;
+        long long moved=0; groups=0;
+        for (int w=0; w<idx; w++){
+            map<string,vector<string>> take;          // org -> days that move
+            istringstream is(held[w]); string line;
+            while (getline(is,line)){
+                auto f=splitEscaped(line);
+                if (f.size()==3 && ownerOf(f[0],f[1])==idx){ take[f[0]].push_back(f[1]); groups++; }
+            }
+            for (const auto& t: take){
+                string req="T\t"+escapeField(t.first); for (const auto& d: t.second) req+='\t'+escapeField(d);
+                string taken, ack;
+                if (!workers[w]->call(req+'\n',taken)) continue;
+                string put=request({"P",t.first,to_string(count(taken.begin(),taken.end(),'\n'))})+taken;
+                if (workers[idx]->call(put,ack)) moved+=(long long)countOf(ack);
+                else workers[w]->call(put,ack);              // keep them where they were
+            }
+        }
+        return moved;
+    }
+
+    // Line protocol on `in`, answered like --serve: "<seq> OK|ERR <bytes>"
+    // then the body. org= and format= prefixes work as for the server.
+    int run(istream& in, ostream& os){
+        string line, row; uint64_t seq=0;
+        while (getline(in,line)){
+            if (!line.empty() && line.back()=='\r') line.pop_back();
+            if (line.empty()) continue;
+            string org="default", body; OutputFormat fmt=OutputFormat::Table; bool badFormat=false;
+            while (line.compare(0,7,"format=")==0 || line.compare(0,4,"org=")==0){
+                size_t sp=line.find(' '), eq=line.find('=');
+                string value=line.substr(eq+1,sp==string::npos ? string::npos : sp-eq-1);
+                if (line[0]=='o') org=value; else if (!parseOutputFormat(value,fmt)) badFormat=true;
+                line = sp==string::npos ? "" : line.substr(sp+1);
+            }
+            size_t sp=line.find(' ');
+            string cmd=line.substr(0,sp), arg = sp==string::npos ? "" : line.substr(sp+1);
+            vector<string> payload;
+            if (cmd=="ADDMANY") while (getline(in,row) && row!="END" && row!="END\r") payload.push_back(row);
+            bool ok;
+            if (badFormat){ ok=false; body="Unknown format (table, csv, tsv, json).\n"; }
+            else if (org.empty()){ ok=false; body="Empty organization.\n"; }
+            else ok=handle(org,cmd,arg,fmt,payload,body);
+            os<<++seq<<' '<<(ok ? "OK" : "ERR")<<' '<<body.size()<<'\n'<<body<<flush;
+        }
+        return 0;
+    }
+};
+
+// ------------------- Multi-tenant host -------------------
+// Hosts one EventManager per organization in a single process. Each tenant
+// has a memory quota; when resident calendars exceed the host budget, the
+// least recently used idle tenants are written to <spillDir>/<org>.tenant and
+// dropped, then transparently reloaded on next access. Tenants with live
+// watches, or pinned by a server request in progress, stay in memory
+// (subscriptions aren't persisted). A spilled tenant whose next automatic
+// reminder comes due is reloaded by tick(). Spill files are written to a
+// .tmp file and renamed into place, kept after a reload, and rewritten for
+// every resident tenant by spillAll() at shutdown. A file that fails to
+// load is renamed to .corrupt and reported; the tenant starts empty.
+class TenantHost {
+    struct Tenant {
+        unique_ptr<EventManager> mgr; list<string>::iterator lru; size_t bytes=0; int pins=0;
+        bool onDisk=false;              // a spill file holds this tenant's last state
+        vector<int> reminderOffsets{24*60, 60};
+        long long spilledAt = 0, nextDue = LLONG_MAX;   // reminder clock when this process evicted it (0: never)
+    };
+    unordered_map<string,Tenant> tenants;
+    list<string> lru;               // front = most recently used
+    size_t tenantQuota, budget, residentBytes = 0;
+    string spillDir;
+    size_t evictions = 0, reloads = 0;
+
+    string spillPath(const string& org) const { return spillFile(spillDir,org); }
+
+    bool writeSpill(Tenant& t, const string& org){
+        if (!writeFile(*t.mgr,spillPath(org))) return false;
+        t.onDisk=true;
+        return true;
+    }
+
+    bool evict(Tenant& t, const string& org){
+        if (!writeSpill(t,org)) return false;            // keep it resident
+        t.spilledAt = t.mgr->reminderClock(); t.nextDue = t.mgr->nextReminderDue();
+        residentBytes -= t.bytes; t.bytes=0; t.mgr.reset(); evictions++;
+        return true;
+    }
+
+    void enforceBudget(const string& keep){
+        for (auto it=lru.end(); residentBytes>budget && it!=lru.begin(); ){
+            --it;
+            if (*it==keep) continue;
+            Tenant& t = tenants[*it];
+            if (!t.mgr || t.pins || t.mgr->subscriptionCount()) continue;
+            evict(t,*it);
+        }
+    }
+
+public:
+    static string spillFile(const string& dir, const string& org){
+        string f; for (char c: org) f += isalnum((unsigned char)c)||c=='-'||c=='_' ? c : '_';
+        return dir+"/"+f+".tenant";
+    }
+
+    // Written to path.tmp and renamed, so a crash never leaves half a file.
+    static bool writeFile(const EventManager& mgr, const string& path){
+        string tmp=path+".tmp";
+        {
+            ofstream os(tmp);
+            if (!os || !mgr.saveTo(os) || !os.flush()){ remove(tmp.c_str()); return false; }
+        }
+        if (rename(tmp.c_str(),path.c_str())!=0){ remove(tmp.c_str()); return false; }
+        return true;
+    }
+
+    TenantHost(size_t quotaPerTenant, size_t residentBudget, string dir="."):
+        tenantQuota(quotaPerTenant), budget(residentBudget), spillDir(move(dir)) {}
+
+    // Returns the tenant's calendar, loading it from its spill file if it was
+    // evicted, and marks it most recently used.
+    EventManager& acquire(const string& org){
+        auto it = tenants.find(org);
+        if (it==tenants.end()){
+            it = tenants.emplace(org,Tenant{}).first;
+            lru.push_front(org); it->second.lru=lru.begin();
+        } else {
+            lru.splice(lru.begin(),lru,it->second.lru);
+        }
+        Tenant& t = it->second;
+        if (!t.mgr){
+            t.mgr = make_unique<EventManager>();
+            long long since = EventManager::nowMinute();
+            string path = spillPath(org);
+            ifstream is(path);
+            if (is){
+                // A file from an earlier process carries no reminder clock:
+                // resume from now, or every past event's reminders would fire.
+                if (t.mgr->loadFrom(is)){ reloads++; if (t.spilledAt) since=t.spilledAt; t.onDisk=true; }
+                else {
+                    is.close(); t.mgr = make_unique<EventManager>(); t.onDisk=false;
+                    string kept = path+".corrupt";
+                    cerr<<"Cannot load "<<path<<" for '"<<org<<"'; "<<(rename(path.c_str(),kept.c_str())==0 ? "kept as "+kept : string("left in place"))<<", starting empty.\n";
+                }
+            }
+            t.mgr->setQuota(tenantQuota);
+            t.mgr->setReminderOffsets(t.reminderOffsets,since);
+            account(org);
+        }
+        enforceBudget(org);
+        return *t.mgr;
+    }
+
+    // Pinned tenants are never evicted; the server pins for each request.
+    void pin(const string& org){ tenants.at(org).pins++; }
+    void unpin(const string& org){ Tenant& t=tenants.at(org); if (t.pins>0) t.pins--; }
+
+    // Write every resident tenant back to its spill file (at shutdown).
+    // Calendars that are still blank and never had a file are skipped.
+    // Returns false if any write failed.
+    bool spillAll(){
+        bool ok=true;
+        for (auto& kv: tenants){
+            Tenant& t=kv.second;
+            if (!t.mgr || (!t.onDisk && t.mgr->isBlank())) continue;
+            if (!writeSpill(t,kv.first)){ cerr<<"Cannot write "<<spillPath(kv.first)<<"\n"; ok=false; }
+        }
+        return ok;
+    }
+
+    // Re-read a tenant's footprint after it changed.
+    void account(const string& org){
+        auto it = tenants.find(org); if (it==tenants.end() || !it->second.mgr) return;
+        account(org,it->second.mgr->memoryBytes());
+    }
+
+    // Same, with the footprint measured by a caller that still held the
+    // calendar's lock (the server: other lanes may be writing it now).
+    void account(const string& org, size_t now){
+        auto it = tenants.find(org); if (it==tenants.end() || !it->second.mgr) return;
+        residentBytes = residentBytes - it->second.bytes + now; it->second.bytes = now;
+        enforceBudget(org);
+    }
+
+    void setReminderOffsets(const string& org, const vector<int>& minutesBefore){
+        Tenant& t = tenants.at(org); t.reminderOffsets = minutesBefore;
+        if (t.mgr) t.mgr->setReminderOffsets(minutesBefore,EventManager::nowMinute());
+    }
+
+    const vector<int>& reminderOffsets(const string& org) const { return tenants.at(org).reminderOffsets; }
+    const string& directory() const { return spillDir; }
+
+    // Tenants with reminders to check: the resident ones, and spilled ones
+    // whose next reminder is due.
+    vector<string> dueTenants(long long nowMinute) const {
+        vector<string> due;
+        for (const auto& t: tenants) if (t.second.mgr || t.second.nextDue<=nowMinute) due.push_back(t.first);
+        return due;
+    }
+
+    // Fire due automatic reminders for every tenant, reloading spilled ones
+    // that have reminders due. Returns the number fired.
+    size_t tick(long long nowMinute, ReminderPipeline& pipeline){
+        size_t fired=0;
+        for (const auto& org: dueTenants(nowMinute)){
+            Tenant& t = tenants[org];
+            if (!t.mgr && t.nextDue>nowMinute) continue;      // spilled meanwhile, nothing due
+            EventManager& m = t.mgr ? *t.mgr : acquire(org);
+            fired += m.fireDueReminders(nowMinute,pipeline);
+        }
+        return fired;
+    }
+
+    size_t tenantCount() const { return tenants.size(); }
+    size_t residentCount() const { size_t n=0; for (const auto& t: tenants) n += t.second.mgr!=nullptr; return n; }
+
+    // Per-subsystem totals over the resident calendars.
+    vector<MemoryPart> memoryBreakdown() const {
+        vector<MemoryPart> parts;
+        for (const auto& t: tenants){
+            if (!t.second.mgr) continue;
+            auto mine=t.second.mgr->memoryBreakdown();
+            if (parts.empty()) parts.assign(mine.begin(),mine.end()); else for (size_t i=0;i<mine.size();i++) parts[i].bytes+=mine[i].bytes;
+        }
+        return parts;
+    }
+
+    void report(ostream& os) const {
+        os<<"Tenants: "<<tenants.size()<<" ("<<residentCount()<<" resident), resident bytes "<<residentBytes<<" / budget "<<budget
+          <<", quota per tenant "<<tenantQuota<<", evictions "<<evictions<<", reloads "<<reloads<<"\n";
+        for (const auto& org: lru){
+            const Tenant& t = tenants.at(org);
+            os<<"  "<<left<<setw(20)<<org<<(t.mgr ? to_string(t.bytes)+" bytes, "+to_string(t.mgr->size())+" events" : string("(spilled)"))<<"\n";
+        }
+    }
+};
+
+// ------------------- Operation log -------------------
+// EVENT_OPLOG=FILE appends every command, from the CLI or --serve, as a
+// server protocol line prefixed with milliseconds since the log was opened:
+//   1530 DAY 12-03-2025
+//   1544 ADDMANY          (rows follow verbatim, then END)
+// CLI actions with no protocol equivalent (edit, attendee pastes, reminders,
+// imports, templates) are not recorded; actions outside the "default"
+// organization carry an org= prefix. Each run starts with a "# session" line and
+// restarts the clock. Writes are buffered and flushed at most once a second.
+class OpLog {
+    using Clock = chrono::steady_clock;
+    mutex mu;
+    ofstream file;
+    Clock::time_point t0;
+    long long lastFlush = 0;
+
+public:
+    bool open(const string& path){
+        file.open(path,ios::app); t0=Clock::now();
+        if (!file) return false;
+        time_t now=time(nullptr); char b[32]; strftime(b,sizeof b,"%Y-%m-%dT%H:%M:%S",localtime(&now));
+        file<<"# session "<<b<<"\n"<<flush;
+        return true;
+    }
+
+    bool enabled() const { return file.is_open(); }
+
+    void record(const string& line, const vector<string>* payload = nullptr){
+        if (!enabled()) return;
+        long long ms=chrono::duration_cast<chrono::milliseconds>(Clock::now()-t0).count();
+        lock_guard<mutex> lk(mu);
+        file<<ms<<' '<<line<<'\n';
+        if (payload){ for (auto& r: *payload) file<<r<<'\n'; file<<"END\n"; }
+        if (ms-lastFlush>=1000){ file.flush(); lastFlush=ms; }
+    }
+};
+
+static OpLog opLog;
+
+// ------------------- Server mode (admission control) -------------------
+// Requests are split into three lanes with their own bounded queue, worker
+// count and default deadline, so a burst of bulk imports can't queue ahead of
+// reads. Work whose deadline passed while queued is shed (never executed);
+// a full queue is reported back immediately as BUSY.
+enum Lane { ReadLane, WriteLane, BulkLane, kLaneCount };
+
+struct LaneConfig { int workers; size_t queueCap; int deadlineMs; };
+
+class AdmissionController {
+    using Clock = chrono::steady_clock;
+    struct Job { Clock::time_point deadline; function<void()> run, shed; };
+    struct LaneState {
+        LaneConfig cfg{};
+        deque<Job> q;
+        mutex mu; condition_variable cv;
+        vector<thread> threads;
+        atomic<uint64_t> admitted{0}, rejected{0}, expired{0}, completed{0};
+    };
+    LaneState lanes[kLaneCount];
+    atomic<bool> stopping{false};
+
+    void workLoop(LaneState& L){
+        while (true){
+            Job job;
+            {
+                unique_lock<mutex> lk(L.mu);
+                L.cv.wait(lk,[&]{ return stopping || !L.q.empty(); });
+                if (L.q.empty()) return;
+                job = move(L.q.front()); L.q.pop_front();
+            }
+            if (Clock::now()>job.deadline){ L.expired++; if (job.shed) job.shed(); continue; }
+            job.run(); L.completed++;
+        }
+    }
+
+public:
+    explicit AdmissionController(const LaneConfig (&cfg)[kLaneCount]){
+        for (int i=0;i<kLaneCount;i++){
+            lanes[i].cfg = cfg[i];
+            for (int w=0; w<max(cfg[i].workers,1); w++) lanes[i].threads.emplace_back([this,i]{ workLoop(lanes[i]); });
+        }
+    }
+
+    ~AdmissionController(){ drain(); }
+
+    // Returns false (and runs nothing) when the lane's queue is full.
+    // deadlineMs < 0 uses the lane default.
+    bool submit(Lane lane, int deadlineMs, function<void()> run, function<void()> shed){
+        LaneState& L = lanes[lane];
+        {
+            lock_guard<mutex> lk(L.mu);
+            if (stopping || L.q.size()>=L.cfg.queueCap){ L.rejected++; return false; }
+            L.q.push_back({Clock::now()+chrono::milliseconds(deadlineMs<0?L.cfg.deadlineMs:deadlineMs), move(run), move(shed)});
+        }
+        L.admitted++; L.cv.notify_one();
+        return true;
+    }
+
+    // Finish queued work and stop the workers.
+    void drain(){
+        if (stopping.exchange(true)) return;
+        for (auto& L: lanes){ L.cv.notify_all(); for (auto& t: L.threads) t.join(); }
+    }
+
+    size_t depth(Lane lane){ lock_guard<mutex> lk(lanes[lane].mu); return lanes[lane].q.size(); }
+    const LaneConfig& config(Lane lane) const { return lanes[lane].cfg; }
+
+    // Prometheus lines from the counters alone; in flight = queued + running.
+    void metrics(string& out) const {
+        static const char* names[] = {"read","write","bulk"};
+        static const char* kinds[] = {"admitted","rejected","expired","completed"};
+        static const char* help[] = {"Requests queued", "Requests refused with BUSY", "Requests shed after their deadline", "Requests executed"};
+        for (int k=0;k<4;k++){
+            out+="# HELP eventmgr_lane_"; out+=kinds[k]; out+="_total "; out+=help[k]; out+=", by lane.\n";
+            out+="# TYPE eventmgr_lane_"; out+=kinds[k]; out+="_total counter\n";
+            for (int i=0;i<kLaneCount;i++){
+                const LaneState& L=lanes[i];
+                const atomic<uint64_t>& v = k==0 ? L.admitted : k==1 ? L.rejected : k==2 ? L.expired : L.completed;
+                out+="eventmgr_lane_"; out+=kinds[k]; out+="_total{lane=\""; out+=names[i]; out+="\"} "; out+=to_string(v.load(memory_order_relaxed)); out+='\n';
+            }
+        }
+        out+="# HELP eventmgr_lane_inflight Requests queued or running, by lane.\n# TYPE eventmgr_lane_inflight gauge\n";
+        for (int i=0;i<kLaneCount;i++){
+            const LaneState& L=lanes[i];
+            uint64_t done=L.completed.load(memory_order_relaxed)+L.expired.load(memory_order_relaxed), in=L.admitted.load(memory_order_relaxed);
+            out+="eventmgr_lane_inflight{lane=\""; out+=names[i]; out+="\"} "; out+=to_string(in>done ? in-done : 0); out+='\n';
+        }
+        out+="# HELP eventmgr_lane_queue_capacity Queue bound, by lane.\n# TYPE eventmgr_lane_queue_capacity gauge\n";
+        for (int i=0;i<kLaneCount;i++){ out+="eventmgr_lane_queue_capacity{lane=\""; out+=names[i]; out+="\"} "; out+=to_string(lanes[i].cfg.queueCap); out+='\n'; }
+    }
+
+    void status(ostream& os){
+        static const char* names[] = {"read","write","bulk"};
+        for (int i=0;i<kLaneCount;i++){
+            LaneState& L=lanes[i];
+            os<<names[i]<<": depth "<<depth((Lane)i)<<"/"<<L.cfg.queueCap<<", workers "<<L.cfg.workers<<", admitted "<<L.admitted<<", completed "<<L.completed
+              <<", rejected "<<L.rejected<<", expired "<<L.expired<<"\n";
+        }
+    }
+};
+
+// Line protocol (one request per line, fields after the command split on '|',
+// with \| and \\ for a literal '|' or backslash inside a field):
+//   LIST | DAY <date> | TODAY | SEARCH <kw> | STATS | EXPORT      (read lane)
+//   WEEK <date> | MONTH <MM-YYYY> | MEMORY                         (read lane)
+//   ADD name|date|time|type|location | DEL <id> | DELNAME <name> (write lane)
+//   ADDMANY  followed by ADD-style lines, terminated by END        (bulk lane)
+//   STATUS   lane depths/counters, answered inline
+//   LATENCY  per-operation latency histograms, answered inline
+//   METRICS  Prometheus text exposition (also GET /metrics with --metrics-port)
+//   TRACE    Chrome trace JSON of recent spans (-DEVENT_TRACING builds), inline
+// Optional leading "deadline=<ms>" overrides the lane deadline; "format=<table|
+// csv|tsv|json>" selects the output of LIST, DAY, TODAY, SEARCH, WEEK, MONTH,
+// STATS, EXPORT, MEMORY and LATENCY; "org=<name>" addresses that organization's calendar
+// (default "default"), loaded from or spilled to <EVENT_SPILL_DIR> as needed.
+// Resident calendars are written back to their spill files when stdin ends.
+// Automatic reminders fire as in the CLI (--serve only, not --replay): a
+// ticker checks every 15 s and fires each tenant's due timers under its
+// exclusive lock, like a write.
+// Every response is "<seq> <OK|BUSY|EXPIRED|ERR> <bytes>\n" + body.
+// A client (stdin, or one --replay thread) reads its own writes: a read is
+// held until every write the client sent before it has answered, then
+// submitted (its deadline starts then). Reads still run in parallel with
+// each other and with writes; a read may also see writes the client sent
+// after it, if those ran first.
+struct ServerOptions {
+    LaneConfig lanes[kLaneCount] = {
+        {(int)max(2u,thread::hardware_concurrency()), 1024, 200},   // reads
+        {1, 256, 2000},                                              // writes
+        {1, 8, 60000},                                               // bulk
+    };
+    size_t bulkChunk = 256;   // rows per exclusive-lock hold during ADDMANY
+};
+
+class Server {
+    TenantHost& host;
+    ServerOptions opt;
+    mutex hostMu;             // TenantHost bookkeeping: acquire, pin, account
+    mutex outMu;
+    AdmissionController ac;
+    ostream& replies;
+    atomic<uint64_t> seq{0};
+    atomic<uint64_t> answered[4] = {};        // OK, BUSY, EXPIRED, ERR
+    atomic<uint64_t> lastScrapeNs{0};
+
+    // Store gauges, republished under the tenant's exclusive lock after
+    // every write (all O(1) reads) so a scrape loads atomics instead of
+    // locking any store.
+    struct Gauges {
+        atomic<uint64_t> events{0}, days{0}, lsn{0}, logRecords{0}, reminders{0}, subscriptions{0};
+        atomic<uint64_t> bytes[EventManager::kMemoryParts] = {};
+        const char* parts[EventManager::kMemoryParts] = {};
+    };
+
+    // One per organization ever addressed; never erased. Reads share mu,
+    // writes and bulk chunks hold it exclusively.
+    struct Slot { string org; shared_mutex mu; Gauges gauges; };
+    mutex slotsMu;
+    map<string,unique_ptr<Slot>> slots;
+
+    Slot& slot(const string& org){
+        lock_guard<mutex> lk(slotsMu);
+        auto& p=slots[org]; if (!p){ p=make_unique<Slot>(); p->org=org; }
+        return *p;
+    }
+
+    // The calendar stays resident (not evictable) until release(). Writers
+    // pass the footprint they measured under the slot's exclusive lock; the
+    // calendar itself isn't read here, since the lock is already released.
+    EventManager& pin(const string& org){ lock_guard<mutex> lk(hostMu); EventManager& m=host.acquire(org); host.pin(org); return m; }
+    void release(const string& org){ lock_guard<mutex> lk(hostMu); host.unpin(org); }
+    void release(const string& org, size_t bytes){
+        lock_guard<mutex> lk(hostMu);
+        host.account(org,bytes);
+        host.unpin(org);
+    }
+
+    static void publish(Gauges& g, const EventManager& m){
+        auto st=[](atomic<uint64_t>& a, uint64_t v){ a.store(v,memory_order_relaxed); };
+        st(g.events,m.size()); st(g.days,m.dayCount()); st(g.lsn,(uint64_t)m.currentLsn());
+        st(g.logRecords,m.logSize()); st(g.reminders,m.pendingReminders()); st(g.subscriptions,m.subscriptionCount());
+        auto mem=m.memoryBreakdown();
+        for (int i=0;i<EventManager::kMemoryParts;i++){ g.parts[i]=mem[i].name; st(g.bytes[i],mem[i].bytes); }
+    }
+
+    void respond(uint64_t id, const char* status, const string& body){
+        static const char* kinds[] = {"OK","BUSY","EXPIRED"};
+        int k=0; while (k<3 && strcmp(status,kinds[k])) k++;
+        answered[k]++;
+        {
+            lock_guard<mutex> lk(outMu);
+            replies<<id<<' '<<status<<' '<<body.size()<<'\n'<<body<<flush;
+        }
+        if (onAnswer) onAnswer(id);
+    }
+
+    // Run fn with out() captured into the response body.
+    template<class Fn> void execute(uint64_t id, Fn fn){
+        TRACE_SPAN("server.request");
+        ostringstream buf; tlsOut=&buf; fn(); tlsOut=nullptr;
+        respond(id,"OK",buf.str());
+    }
+
+    static void addRow(EventManager& mgr, const string& row){
+        auto f=splitFields(row);
+        if (f.size()<4){ out()<<"Expected name|date|time|type|location.\n"; return; }
+        mgr.addEvent(f[0],f[1],f[2],f[3],f.size()>4?f[4]:"");
+    }
+
+public:
+    struct Client {
+        set<uint64_t> openWrites;                              // seqs queued or running
+        deque<pair<uint64_t,function<void()>>> held;           // (last write before it, submit)
+    };
+
+private:
+    mutex clientMu; condition_variable clientCv;
+    int openWritesAll = 0;
+    Client console;                           // run()'s stdin
+
+    ReminderPipeline* reminders = nullptr;    // set by startReminders()
+    thread ticker;
+    mutex tickMu; condition_variable tickCv; bool stopTicker = false;
+
+    // Write `id` from cl answered (or was refused): release the held reads
+    // whose earlier writes have all answered now.
+    void writeSettled(Client* cl, uint64_t id){
+        vector<function<void()>> go;
+        {
+            lock_guard<mutex> lk(clientMu); cl->openWrites.erase(id);
+            while (!cl->held.empty() && (cl->openWrites.empty() || cl->held.front().first<*cl->openWrites.begin())){
+                go.push_back(move(cl->held.front().second)); cl->held.pop_front();
+            }
+        }
+        for (auto& f: go) f();
+        { lock_guard<mutex> lk(clientMu); openWritesAll--; }
+        clientCv.notify_all();
+    }
+
+    void admit(uint64_t id, const string& org, const string& cmd, const string& arg, int deadlineMs, OutputFormat fmt, vector<string> payload, Lane lane, Client* cl){
+        if (dispatch(id,org,cmd,arg,deadlineMs,fmt,move(payload),lane==ReadLane ? nullptr : cl)) return;
+        const LaneConfig& c = ac.config(lane);
+        respond(id,"BUSY","queue full ("+to_string(ac.depth(lane))+"/"+to_string(c.queueCap)+"); retry-after-ms "+to_string(max(10,c.deadlineMs/4))+"\n");
+        if (lane!=ReadLane) writeSettled(cl,id);
+    }
+
+    // writer: the client to settle when a write job answers (null for reads).
+    bool dispatch(uint64_t id, const string& org, const string& cmd, const string& arg, int deadlineMs, OutputFormat fmt, vector<string> payload, Client* writer){
+        auto shed=[this,id,writer]{ respond(id,"EXPIRED","deadline passed while queued\n"); if (writer) writeSettled(writer,id); };
+        Slot* sl=&slot(org);
+        auto readJob=[&](function<void(EventManager&)> fn){ return ac.submit(ReadLane,deadlineMs,[this,id,sl,fn]{
+            EventManager& m=pin(sl->org);
+            { shared_lock<shared_mutex> lk(sl->mu); execute(id,[&]{ fn(m); }); }
+            release(sl->org);
+        },shed); };
+        auto writeJob=[&](function<void(EventManager&)> fn){ return ac.submit(WriteLane,deadlineMs,[this,id,sl,fn,writer]{
+            EventManager& m=pin(sl->org); size_t bytes;
+            { unique_lock<shared_mutex> lk(sl->mu); execute(id,[&]{ fn(m); publish(sl->gauges,m); }); bytes=m.memoryBytes(); }
+            release(sl->org,bytes);
+            writeSettled(writer,id);
+        },shed); };
+        if (cmd=="LIST"||cmd=="DAY"||cmd=="TODAY"||cmd=="WEEK"||cmd=="MONTH"||cmd=="SEARCH")
+            return readJob([cmd,arg,fmt](EventManager& m){ runViewerRead(m,cmd,arg,fmt); });
+        if (cmd=="STATS")  return readJob([fmt](EventManager& m){ m.statistics(fmt); });
+        if (cmd=="MEMORY") return readJob([fmt](EventManager& m){
+            auto mine=m.memoryBreakdown(); vector<MemoryPart> parts(mine.begin(),mine.end());
+            parts.push_back({"latency histograms",opLatency.memoryBytes()});
+            if (size_t t=traceBytes()) parts.push_back({"trace rings",t});
+            writeMemoryReport(out(),parts,fmt);
+        });
+        if (cmd=="EXPORT") return readJob([fmt](EventManager& m){ m.exportSnapshotCSV(fmt); });
+        if (cmd=="ADD")    return writeJob([arg](EventManager& m){ addRow(m,arg); });
+        if (cmd=="DEL")    return writeJob([arg](EventManager& m){ try { m.deleteById(stoi(arg)); } catch (...) { out()<<"Invalid ID.\n"; } });
+        if (cmd=="DELNAME") return writeJob([arg](EventManager& m){ m.deleteByName(arg); });
+        if (cmd=="ADDMANY"){
+            auto rows = make_shared<vector<string>>(move(payload));
+            return ac.submit(BulkLane,deadlineMs,[this,id,sl,rows,writer]{
+                EventManager& m=pin(sl->org);
+                ostringstream buf; tlsOut=&buf;
+                size_t added=0, chunk=max<size_t>(opt.bulkChunk,1), bytes=0;
+                for (size_t i=0;i<rows->size();i+=chunk){
+                    // Short exclusive holds so queued reads get the lock between chunks.
+                    unique_lock<shared_mutex> lk(sl->mu);
+                    for (size_t j=i;j<min(i+chunk,rows->size());j++){
+                        auto f=splitFields((*rows)[j]);
+                        if (f.size()>=4 && m.addEvent(f[0],f[1],f[2],f[3],f.size()>4?f[4]:"",false)) added++;
+                    }
+                    publish(sl->gauges,m); bytes=m.memoryBytes();
+                }
+                tlsOut=nullptr;
+                if (rows->empty()) release(sl->org); else release(sl->org,bytes);
+                respond(id,"OK","Added "+to_string(added)+" of "+to_string(rows->size())+" events.\n");
+                writeSettled(writer,id);
+            },shed);
+        }
+        respond(id,"ERR","Unknown command.\n");
+        return true;
+    }
+
+public:
+    function<void(uint64_t)> onAnswer;       // after each response, with its seq
 
-static bool icontains(const string& text, const string& key){
-    string t=toLower(text), k=toLower(key);
-    return t.find(k)!=string::npos;
-}
+    Server(TenantHost& h, const ServerOptions& o, ostream& out = cout): host(h), opt(o), ac(o.lanes), replies(out) {
+        // Gauges for the default calendar (possibly loaded from a spill file) from the start.
+        Slot& sl=slot("default"); publish(sl.gauges,pin("default")); release("default");
+    }
 
-class EventManager {
-    vector<Event> events;
-    int nextId = 1;
-    vector<string> attendeeEmails; // loaded via paste
+    // Command word of a request line, past any deadline=/format=/org= prefixes.
+    static string commandOf(const string& line){
+        size_t p=0;
+        while (line.compare(p,9,"deadline=")==0 || line.compare(p,7,"format=")==0 || line.compare(p,4,"org=")==0){
+            size_t sp=line.find(' ',p); if (sp==string::npos) return "";
+            p=sp+1;
+        }
+        return line.substr(p,line.find(' ',p)-p);
+    }
 
-public:
-    // ------------------- Validation -------------------
-    static bool isLeap(int y){ return (y%4==0 && y%100!=0) || (y%400==0); }
+    int run(istream& in){
+        string line, row;
+        while (getline(in,line)){
+            if (!line.empty() && line.back()=='\r') line.pop_back();
+            if (line.empty()) continue;
+            vector<string> payload;
+            bool bulk = commandOf(line)=="ADDMANY";
+            if (bulk) while (getline(in,row) && row!="END" && row!="END\r") payload.push_back(row);
+            opLog.record(line,bulk ? &payload : nullptr);
+            handle(line,move(payload),console);
+        }
+        drain();
+        return 0;
+    }
 
-    static bool isValidDate(const string& d){
-        // expect DD-MM-YYYY with digits and '-'
-        if (d.size()!=10 || d[2]!='-' || d[5]!='-') return false;
-        for (int i=0;i<10;i++){ if (i==2||i==5) continue; if (!isdigit((unsigned char)d[i])) return false; }
-        int day = stoi(d.substr(0,2));
-        int mon = stoi(d.substr(3,2));
-        int yr  = stoi(d.substr(6,4));
-        if (yr<1900 || yr>3000) return false;
-        if (mon<1 || mon>12) return false;
-        int mdays[] = {0,31,28,31,30,31,30,31,31,30,31,30,31};
-        if (mon==2 && isLeap(yr)) mdays[2]=29;
-        return day>=1 && day<=mdays[mon];
+    // One request from client; ADDMANY rows come in payload. Returns its
+    // seq. Safe to call from several threads (--replay does), each with
+    // its own Client.
+    uint64_t handle(string line, vector<string> payload, Client& client){
+        uint64_t id = ++seq;
+        int deadlineMs = -1; OutputFormat fmt = OutputFormat::Table; bool badFormat=false;
+        string org = "default";
+        while (line.compare(0,9,"deadline=")==0 || line.compare(0,7,"format=")==0 || line.compare(0,4,"org=")==0){
+            size_t sp=line.find(' '), eq=line.find('=');
+            string value=line.substr(eq+1,sp==string::npos ? string::npos : sp-eq-1);
+            if (line[0]=='d'){ try { deadlineMs=stoi(value); } catch (...) {} }
+            else if (line[0]=='o') org=value;
+            else if (!parseOutputFormat(value,fmt)) badFormat=true;
+            line = sp==string::npos ? "" : line.substr(sp+1);
+        }
+        size_t sp=line.find(' ');
+        string cmd=line.substr(0,sp), arg = sp==string::npos ? "" : line.substr(sp+1);
+        if (cmd=="STATUS"){ ostringstream os; ac.status(os); respond(id,"OK",os.str()); return id; }
+        if (badFormat){ respond(id,"ERR","Unknown format (table, csv, tsv, json).\n"); return id; }
+        if (org.empty()){ respond(id,"ERR","Empty organization.\n"); return id; }
+        if (cmd=="LATENCY"){ ostringstream os; opLatency.report(os,fmt); respond(id,"OK",os.str()); return id; }
+        if (cmd=="METRICS"){ respond(id,"OK",metrics()); return id; }
+        if (cmd=="TRACE"){ ostringstream os; if (traceDump(os)) respond(id,"OK",os.str()); else respond(id,"ERR","Tracing is compiled out (build with -DEVENT_TRACING).\n"); return id; }
+        Lane lane = cmd=="ADDMANY" ? BulkLane : (cmd=="ADD"||cmd=="DEL"||cmd=="DELNAME") ? WriteLane : ReadLane;
+        {
+            lock_guard<mutex> lk(clientMu);
+            if (lane!=ReadLane){ client.openWrites.insert(id); openWritesAll++; }
+            else if (!client.openWrites.empty()){
+                client.held.push_back({*client.openWrites.rbegin(),[this,id,org,cmd,arg,deadlineMs,fmt,cl=&client]{ admit(id,org,cmd,arg,deadlineMs,fmt,{},ReadLane,cl); }});
+                return id;
+            }
+        }
+        admit(id,org,cmd,arg,deadlineMs,fmt,move(payload),lane,&client);
+        return id;
     }
 
-    static bool isValidTime(const string& t){
-        // expect HH:MM with digits and ':'
-        if (t.size()!=5 || t[2] != ':') return false;
-        if (!isdigit((unsigned char)t[0]) || !isdigit((unsigned char)t[1]) ||
-            !isdigit((unsigned char)t[3]) || !isdigit((unsigned char)t[4])) return false;
-        int h = (t[0]-'0')*10 + (t[1]-'0');
-        int m = (t[3]-'0')*10 + (t[4]-'0');
-        if (h<0 || h>23) return false;
-        if (m<0 || m>59) return false;
-        return true;
+    // Fire automatic reminders in the background until stopReminders().
+    void startReminders(ReminderPipeline& pipeline){
+        reminders=&pipeline;
+        ticker=thread([this]{
+            unique_lock<mutex> lk(tickMu);
+            while (!stopTicker){ lk.unlock(); fireReminders(EventManager::nowMinute()); lk.lock(); tickCv.wait_for(lk,chrono::seconds(15)); }
+        });
     }
 
-    static int toMinutes(const string& t){ return (t[0]-'0')*600 + (t[1]-'0')*60 + (t[3]-'0')*10 + (t[4]-'0'); }
+    void stopReminders(){
+        { lock_guard<mutex> lk(tickMu); stopTicker=true; }
+        tickCv.notify_all();
+        if (ticker.joinable()) ticker.join();
+    }
 
-    static string fromMinutes(int minutes){
-        if (minutes<0) minutes=0; minutes %= (24*60);
-        int h = minutes/60, m = minutes%60;
-        ostringstream os; os<<setw(2)<<setfill('0')<<h<<":"<<setw(2)<<setfill('0')<<m; return os.str();
+    ~Server(){ stopReminders(); }
+
+    // TenantHost::tick() with the server's locking: each due tenant is
+    // pinned and fired under its slot's exclusive lock.
+    size_t fireReminders(long long nowMinute){
+        vector<string> due;
+        { lock_guard<mutex> lk(hostMu); due=host.dueTenants(nowMinute); }
+        size_t fired=0;
+        for (const auto& org: due){
+            Slot* sl=&slot(org);
+            EventManager& m=pin(org); size_t bytes;
+            {
+                unique_lock<shared_mutex> lk(sl->mu);
+                fired += m.fireDueReminders(nowMinute,*reminders);
+                publish(sl->gauges,m); bytes=m.memoryBytes();
+            }
+            release(org,bytes);
+        }
+        return fired;
     }
 
-    static bool conflicts(const Event& a, const Event& b){
-        if (a.date!=b.date) return false;
-        int s1=toMinutes(a.time), e1=s1+60; // assume 60-minute events
-        int s2=toMinutes(b.time), e2=s2+60;
-        return (s1<e2 && s2<e1);
+    // Held reads go out before the lanes stop taking work.
+    void drain(){
+        { unique_lock<mutex> lk(clientMu); clientCv.wait(lk,[&]{ return openWritesAll==0; }); }
+        ac.drain();
     }
 
-    // ------------------- Utilities -------------------
-    static string today(){
-        using namespace chrono;
-        auto now = system_clock::now();
-        time_t tt = system_clock::to_time_t(now);
-        tm local{};
-        #ifdef _WIN32
-            localtime_s(&local, &tt);
-        #else
-            local = *localtime(&tt);
-        #endif
-        ostringstream os;
-        os<<setw(2)<<setfill('0')<<local.tm_mday<<"-"<<setw(2)<<setfill('0')<<(local.tm_mon+1)<<"-"<<(local.tm_year+1900);
-        return os.str();
+    // Prometheus text format, version 0.0.4. Reads only atomics and the
+    // latency shards, never storeMu. Histogram buckets are the HDR buckets
+    // whose upper edge fits under each bound, so a sample near a bound may
+    // land one bound higher. There is no cache in the serving path and no
+    // follower in server mode: the WAL shows up as head LSN and retained
+    // records rather than a lag.
+    string metrics(){
+        auto t0=chrono::steady_clock::now();
+        string out; out.reserve(32768);
+        auto metric=[&](const char* name, const char* type, const char* help){ out+="# HELP "; out+=name; out+=' '; out+=help; out+="\n# TYPE "; out+=name; out+=' '; out+=type; out+='\n'; };
+        char b[160];
+
+        metric("eventmgr_requests_total","counter","Requests answered, by response status.");
+        static const char* statuses[] = {"ok","busy","expired","err"};
+        for (int i=0;i<4;i++){ snprintf(b,sizeof b,"eventmgr_requests_total{status=\"%s\"} %llu\n",statuses[i],(unsigned long long)answered[i].load(memory_order_relaxed)); out+=b; }
+        ac.metrics(out);
+
+        static const double bounds[] = {1e-6,2.5e-6,5e-6,1e-5,2.5e-5,5e-5,1e-4,2.5e-4,5e-4,1e-3,2.5e-3,5e-3,1e-2,2.5e-2,5e-2,0.1,0.25,0.5,1,2.5,5,10};
+        metric("eventmgr_op_duration_seconds","histogram","EventManager operation latency.");
+        for (int op=0; op<kOpCount; op++){
+            LatencyStats::Summary m=opLatency.summary((OpId)op);
+            uint64_t cum=0; int bucket=0;
+            for (double le: bounds){
+                for (; bucket<LatencyStats::kBuckets && LatencyStats::upperEdge(bucket)<=(uint64_t)(le*1e9); bucket++) cum+=m.buckets[bucket];
+                snprintf(b,sizeof b,"eventmgr_op_duration_seconds_bucket{op=\"%s\",le=\"%g\"} %llu\n",kOpNames[op],le,(unsigned long long)cum); out+=b;
+            }
+            snprintf(b,sizeof b,"eventmgr_op_duration_seconds_bucket{op=\"%s\",le=\"+Inf\"} %llu\n",kOpNames[op],(unsigned long long)m.count); out+=b;
+            snprintf(b,sizeof b,"eventmgr_op_duration_seconds_sum{op=\"%s\"} %.9f\n",kOpNames[op],m.sumNs/1e9); out+=b;
+            snprintf(b,sizeof b,"eventmgr_op_duration_seconds_count{op=\"%s\"} %llu\n",kOpNames[op],(unsigned long long)m.count); out+=b;
+        }
+
+        // Per-tenant gauges; slots are never erased, so the pointers outlive slotsMu.
+        vector<const Slot*> all;
+        { lock_guard<mutex> lk(slotsMu); for (const auto& kv: slots) all.push_back(kv.second.get()); }
+        auto tenant=[&](const Slot* sl){
+            out+="{tenant=\"";
+            for (char c: sl->org){ if (c=='\\' || c=='"') out+='\\'; if (c=='\n') out+="\\n"; else out+=c; }
+            out+='"';
+        };
+        struct Gauge { const char* name; const char* help; atomic<uint64_t> Gauges::*field; };
+        static const Gauge gauges[] = {
+            {"eventmgr_store_events","Events in the store.",&Gauges::events},
+            {"eventmgr_index_days","Days in the per-day index.",&Gauges::days},
+            {"eventmgr_wal_lsn","Last mutation log sequence number.",&Gauges::lsn},
+            {"eventmgr_wal_retained_records","Mutation log records retained for followers.",&Gauges::logRecords},
+            {"eventmgr_reminder_timers_pending","Automatic reminders queued in the timer wheel.",&Gauges::reminders},
+            {"eventmgr_subscriptions","Active push subscriptions.",&Gauges::subscriptions},
+        };
+        for (const Gauge& g: gauges){
+            metric(g.name,"gauge",g.help);
+            for (const Slot* sl: all){ out+=g.name; tenant(sl); out+="} "; out+=to_string((sl->gauges.*g.field).load(memory_order_relaxed)); out+='\n'; }
+        }
+        metric("eventmgr_memory_bytes","gauge","Approximate bytes by tenant and subsystem.");
+        for (const Slot* sl: all) for (int i=0;i<EventManager::kMemoryParts;i++){
+            if (!sl->gauges.parts[i]) continue;               // not published yet
+            out+="eventmgr_memory_bytes"; tenant(sl); out+=",part=\""; out+=sl->gauges.parts[i]; out+="\"} ";
+            out+=to_string(sl->gauges.bytes[i].load(memory_order_relaxed)); out+='\n';
+        }
+
+        metric("eventmgr_scrape_duration_seconds","gauge","Time taken to render the previous scrape.");
+        snprintf(b,sizeof b,"eventmgr_scrape_duration_seconds %.9f\n",lastScrapeNs.load(memory_order_relaxed)/1e9); out+=b;
+        lastScrapeNs.store((uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now()-t0).count(),memory_order_relaxed);
+        return out;
+    }
+
+    void tally(ostream& out) const {
+        out<<"Answers: OK "<<answered[0]<<", BUSY "<<answered[1]<<", EXPIRED "<<answered[2]<<", ERR "<<answered[3]<<"\n";
     }
+};
 
-    static string truncate(const string& s, size_t n){ if(s.size()<=n) return s; return s.substr(0,n-1)+"…"; }
+// ------------------- Replay -------------------
+// --replay FILE re-executes an operation log (or an untimed --generate
+// trace) through Server::handle against the tenants it names (org= prefix,
+// else "default"), so admission queues and locking behave as they do under
+// live traffic. Nothing is written back to the spill files afterwards, and
+// automatic reminders don't fire. Requests go out
+// at their recorded offsets (open loop, like the original traffic); with
+// --fast each client sends its next request as soon as the previous one is
+// answered, so N clients keep at most N requests in flight instead of
+// flooding the queues. With --threads N requests are dealt round-robin to N
+// clients, so order holds within a client only. Responses
+// are discarded; the summary gives answers by status, achieved rate, how far
+// sends fell behind schedule and the per-operation latency table.
+struct ReplayEntry { long long ms; string line; vector<string> payload; };
 
-    static void printHeader(){
-        cout<<left
-                 <<setw(5)<<"ID"
-                 <<setw(22)<<"Name"
-                 <<setw(12)<<"Date"
-                 <<setw(8)<<"Time"
-                 <<setw(14)<<"Type"
-                 <<setw(18)<<"Location"<<"\n";
-        cout<<string(79,'-')<<"\n";
+static bool loadReplay(const string& path, vector<ReplayEntry>& out, string& err){
+    ifstream in(path); if (!in){ err="Cannot open "+path; return false; }
+    string line, row; long long last=0, offset=0;
+    while (getline(in,line)){
+        if (!line.empty() && line.back()=='\r') line.pop_back();
+        if (line.empty() || line[0]=='#') continue;
+        ReplayEntry e{last,line,{}};
+        if (isdigit((unsigned char)line[0])){
+            size_t sp=line.find(' ');
+            if (sp==string::npos){ err=path+": timestamp without a request: "+line; return false; }
+            // A later session restarts at 0; keep time moving forward.
+            long long ms=stoll(line.substr(0,sp));
+            if (ms+offset<last) offset=last-ms;
+            e.ms=last=ms+offset; e.line=line.substr(sp+1);
+        }
+        if (Server::commandOf(e.line)=="ADDMANY") while (getline(in,row) && row!="END" && row!="END\r") e.payload.push_back(row);
+        out.push_back(move(e));
     }
+    if (out.empty()){ err=path+": no requests"; return false; }
+    return true;
+}
+
+#ifndef _WIN32
+// ------------------- Metrics endpoint -------------------
+// --serve --metrics-port N answers GET /metrics on 127.0.0.1:N (loopback
+// only) from one thread, one request per connection, HTTP/1.0. A client
+// that stalls for more than a second is dropped.
+class MetricsEndpoint {
+    function<string()> render;
+    int fd = -1;
+    thread loop;
 
-    static void printEvent(const Event& e){
-        cout<<left
-                 <<setw(5)<<e.id
-                 <<setw(22)<<truncate(e.name,20)
-                 <<setw(12)<<e.date
-                 <<setw(8)<<e.time
-                 <<setw(14)<<truncate(e.type,12)
-                 <<setw(18)<<truncate(e.location,16)<<"\n";
+    void serve(){
+        while (true){
+            int c=accept(fd,nullptr,nullptr);
+            if (c<0){ if (errno==EINTR) continue; return; }   // closed by stop()
+            timeval tv{1,0}; setsockopt(c,SOL_SOCKET,SO_RCVTIMEO,&tv,sizeof tv); setsockopt(c,SOL_SOCKET,SO_SNDTIMEO,&tv,sizeof tv);
+            string req; char buf[2048];
+            while (req.find("\r\n\r\n")==string::npos && req.find("\n\n")==string::npos && req.size()<8192){
+                ssize_t n=recv(c,buf,sizeof buf,0); if (n<=0) break;
+                req.append(buf,(size_t)n);
+            }
+            string body, status="200 OK", type="text/plain; version=0.0.4";
+            if (req.compare(0,13,"GET /metrics ")==0 || req.compare(0,13,"GET /metrics?")==0) body=render();
+            else { status="404 Not Found"; type="text/plain"; body="Try GET /metrics\n"; }
+            string resp="HTTP/1.0 "+status+"\r\nContent-Type: "+type+"\r\nContent-Length: "+to_string(body.size())+"\r\nConnection: close\r\n\r\n"+body;
+            for (size_t off=0; off<resp.size(); ){ ssize_t n=::send(c,resp.data()+off,resp.size()-off,MSG_NOSIGNAL); if (n<=0) break; off+=(size_t)n; }
+            close(c);
+        }
     }
 
-    // ------------------- Core Ops -------------------
-    bool isDuplicate(const string& name, const string& date, const string& time){
-        for (const auto& e: events){ if (iequals(e.name,name) && e.date==date && e.time==time) return true; }
-        return false;
+public:
+    explicit MetricsEndpoint(function<string()> r): render(move(r)) {}
+    ~MetricsEndpoint(){ stop(); }
+
+    // Returns the bound port (useful with 0), or -1 with err set.
+    int start(int port, string& err){
+        fd=socket(AF_INET,SOCK_STREAM,0);
+        if (fd<0){ err=strerror(errno); return -1; }
+        int one=1; setsockopt(fd,SOL_SOCKET,SO_REUSEADDR,&one,sizeof one);
+        sockaddr_in a{}; a.sin_family=AF_INET; a.sin_port=htons((uint16_t)port); a.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+        socklen_t len=sizeof a;
+        if (bind(fd,(sockaddr*)&a,sizeof a)!=0 || listen(fd,16)!=0 || getsockname(fd,(sockaddr*)&a,&len)!=0){ err=strerror(errno); close(fd); fd=-1; return -1; }
+        loop=thread([this]{ serve(); });
+        return ntohs(a.sin_port);
     }
 
-    bool addEvent(const string& name,const string& date,const string& time,const string& type,const string& location,bool verbose=true){
-        if (!isValidDate(date)){ if(verbose) cout<<"Invalid date. Use DD-MM-YYYY.\n"; return false; }
-        if (!isValidTime(time)){ if(verbose) cout<<"Invalid time. Use HH:MM (24h).\n"; return false; }
-        if (isDuplicate(name,date,time)){ if(verbose) cout<<"Duplicate event exists.\n"; return false; }
-        Event e{nextId++,name,date,time,type,location};
-        for (const auto& ex: events){ if (conflicts(e,ex)){ if(verbose){ cout<<"Conflict with Event ID "<<ex.id<<" ("<<ex.name<<") at "<<ex.time<<".\n"; suggestSlots(date);} return false; } }
-        events.push_back(e);
-        if(verbose) cout<<"Event added with ID: "<<e.id<<"\n";
+    void stop(){
+        if (fd<0) return;
+        shutdown(fd,SHUT_RDWR);                 // wakes accept()
+        if (loop.joinable()) loop.join();
+        close(fd); fd=-1;
+    }
+};
+#endif
+
+// ------------------- Workload generator -------------------
+// Seeded synthetic calendars for benchmarks and load tests. A catalogue
+// mixes multi-day conference bursts, weekly recurring series and one-off
+// events, with weekday/hour skew and Zipf-distributed popularity for
+// types, locations, name words and attendees. It can be written as menu
+// import CSV, as a spill snapshot (events, attendee pool, registrations),
+// or as a server-protocol trace of mixed reads and writes, or handed to an
+// EventManager directly. Catalogues keep addEvent's rule that starts on one
+// day are at least an hour apart; a day holds at most 24 events, so the
+// window is widened to events/12 days when `days` is too short for it.
+//
+//   --generate events=100000 days=365 format=snapshot out=spill/default.tenant
+//   --generate events=100000 days=365 format=trace ops=50000 > trace.txt
+//   EVENT_SPILL_DIR=spill event-system --serve < trace.txt
+//
+// The same seed and spec always give the same catalogue and trace, so the
+// trace's ids and names refer to events in the matching snapshot. --serve
+// rewrites the snapshot at exit with the trace applied; generate it again
+// before rerunning the trace from the same starting point.
+
+// splitmix64
+struct SeededRng {
+    uint64_t s;
+    uint64_t next(){ uint64_t z=(s+=0x9E3779B97F4A7C15ULL); z=(z^(z>>30))*0xBF58476D1CE4E5B9ULL; z=(z^(z>>27))*0x94D049BB133111EBULL; return z^(z>>31); }
+    size_t below(size_t n){ return (size_t)(next()%n); }
+    double unit(){ return (double)(next()>>11)*0x1.0p-53; }
+};
+
+// Rank i (0-based) drawn with weight 1/(i+1)^s.
+class Zipf {
+    vector<double> cdf;
+public:
+    Zipf(size_t n, double s): cdf(max<size_t>(n,1)) {
+        double sum=0; for (size_t i=0;i<cdf.size();i++){ sum+=1.0/pow((double)i+1,s); cdf[i]=sum; }
+        for (double& c: cdf) c/=sum;
+    }
+    size_t operator()(SeededRng& r) const { return min(cdf.size()-1,(size_t)(lower_bound(cdf.begin(),cdf.end(),r.unit())-cdf.begin())); }
+};
+
+struct WorkloadSpec {
+    uint64_t seed = 1;
+    size_t events = 10000;
+    long long firstDay = 20089;     // days since 1970-01-01 (01-01-2025)
+    int days = 365;
+    double weekend = 0.15;          // weekend day weight relative to a weekday
+    double zipf = 1.1;              // skew of type, location, word and attendee popularity
+    size_t locations = 40, vocab = 48;
+    double bursts = 0.15;           // share of events in conference bursts
+    double series = 0.3;            // share in weekly recurring series
+    size_t people = 2000;
+    double attendees = 6;           // mean registrations per event, 0 = none
+    size_t ops = 10000;             // trace length
+    double writes = 0.1;            // share of trace ops that mutate
+
+    bool set(const string& key, const string& value){
+        try {
+            if (key=="seed") seed=stoull(value);
+            else if (key=="events") events=stoull(value);
+            else if (key=="start"){ if (!EventManager::isValidDate(value)) return false; int k=EventManager::dayKey(value); firstDay=EventManager::daysFromCivil(k/10000,k/100%100,k%100); }
+            else if (key=="days") days=max(1,stoi(value));
+            else if (key=="weekend") weekend=stod(value);
+            else if (key=="zipf") zipf=stod(value);
+            else if (key=="locations") locations=max<size_t>(1,stoull(value));
+            else if (key=="vocab") vocab=max<size_t>(2,stoull(value));
+            else if (key=="bursts") bursts=min(1.0,max(0.0,stod(value)));
+            else if (key=="series") series=min(1.0,max(0.0,stod(value)));
+            else if (key=="people") people=max<size_t>(1,stoull(value));
+            else if (key=="attendees") attendees=max(0.0,stod(value));
+            else if (key=="ops") ops=stoull(value);
+            else if (key=="writes") writes=min(1.0,max(0.0,stod(value)));
+            else return false;
+        } catch (...) { return false; }
         return true;
     }
+};
 
-    bool editEventById(int id){
-        auto it = find_if(events.begin(),events.end(),[&](const Event& e){return e.id==id;});
-        if (it==events.end()){ cout<<"Event not found.\n"; return false; }
-        Event backup=*it; Event &e=*it; string in;
-        cout<<"Editing Event (leave blank to keep current)\n";
-        cout<<"Name ["<<e.name<<"]: "; getline(cin,in); if(!in.empty()) e.name=in;
-        cout<<"Date ["<<e.date<<"]: "; getline(cin,in); if(!in.empty()) e.date=in;
-        cout<<"Time ["<<e.time<<"]: "; getline(cin,in); if(!in.empty()) e.time=in;
-        cout<<"Type ["<<e.type<<"]: "; getline(cin,in); if(!in.empty()) e.type=in;
-        cout<<"Location ["<<e.location<<"]: "; getline(cin,in); if(!in.empty()) e.location=in;
-        if (!isValidDate(e.date) || !isValidTime(e.time)){ cout<<"Invalid date/time. Reverting.\n"; e=backup; return false; }
-        for (const auto& ex: events){ if (ex.id!=e.id && iequals(ex.name,e.name) && ex.date==e.date && ex.time==e.time){ cout<<"Duplicate after edit. Reverting.\n"; e=backup; return false; } }
-        for (const auto& ex: events){ if (ex.id!=e.id && conflicts(e,ex)){ cout<<"Conflict after edit with ID "<<ex.id<<". Reverting.\n"; suggestSlots(e.date); e=backup; return false; } }
-        cout<<"Event updated.\n"; return true;
+struct Catalogue {
+    vector<Event> events;                      // ids 1..n
+    vector<string> people;
+    vector<pair<int,string>> registrations;    // sorted (event id, email)
+};
+
+class WorkloadGen {
+    static constexpr const char* kWords[48] = {
+        "Budget","Design","Product","Sales","Hiring","Security","Platform","Roadmap","Customer","Quarterly","Team","Data",
+        "Launch","Marketing","Finance","Legal","Research","Mobile","Cloud","Support","Strategy","Partner","Release","Ops",
+        "Review","Planning","Standup","Retro","Sync","Workshop","Training","Interview","Demo","Briefing","Kickoff","Townhall",
+        "Lunch","Offsite","Hackday","Webinar","Onboarding","Mentoring","Audit","Forecast","Pricing","Analytics","Infra","Growth"};
+    static constexpr const char* kTypes[12] = {"meeting","review","standup","interview","workshop","training",
+                                               "social","demo","webinar","offsite","talk","keynote"};
+    static constexpr const char* kFirst[16] = {"alex","sam","jordan","taylor","casey","riley","morgan","jamie",
+                                               "robin","drew","kim","lee","pat","chris","dana","quinn"};
+    static constexpr const char* kDomains[8] = {"example.com","example.org","example.net","corp.example",
+                                                "mail.example","uni.example","partner.example","agency.example"};
+    // Relative start-hour popularity: office hours, dips at lunch.
+    static constexpr double kHourWeight[24] = {0,0,0,0,0,0,0.1,0.4,1.5,3,3.5,3,1.5,2,3,3,2.5,1.2,0.5,0.4,0.3,0.1,0,0};
+
+    WorkloadSpec spec;
+    SeededRng rng;
+    Zipf typeZ, locZ, wordZ, personZ;
+    unordered_map<long long,vector<int>> taken;     // day -> claimed start minutes, sorted
+
+    // Claims minute on day unless it is within an hour of a claimed start.
+    bool claim(long long day, int minute){
+        auto& v=taken[day]; auto it=lower_bound(v.begin(),v.end(),minute);
+        if ((it!=v.end() && *it-minute<60) || (it!=v.begin() && minute-*(it-1)<60)) return false;
+        v.insert(it,minute); return true;
+    }
+    // The wanted minute, else the nearest free quarter hour; -1 if the day is full.
+    int slotOn(long long day, int minute){
+        if (claim(day,minute)) return minute;
+        for (int d=15; d<24*60; d+=15)
+            for (int m: {minute-d, minute+d}) if (m>=0 && m<24*60 && claim(day,m)) return m;
+        return -1;
     }
 
-    bool deleteById(int id){
-        auto before = events.size();
-        events.erase(remove_if(events.begin(),events.end(),[&](const Event& e){return e.id==id;}),events.end());
-        if (events.size()==before){ cout<<"No event with that ID.\n"; return false; }
-        cout<<"Deleted.\n"; return true;
+    long long pickDay(){
+        for (;;){
+            long long d=spec.firstDay+(long long)rng.below((size_t)spec.days);
+            if (EventManager::weekdayMon0(d)<5 || rng.unit()<spec.weekend) return d;
+        }
+    }
+    int pickMinute(){
+        double total=0; for (double w: kHourWeight) total+=w;
+        double u=rng.unit()*total; int h=0;
+        while (h<23 && (u-=kHourWeight[h])>=0) h++;
+        return h*60 + (rng.unit()<0.85 ? (int)rng.below(4)*15 : (int)rng.below(60));
     }
+    string word(){ return word(wordZ(rng)); }
+    string title(){ size_t a=wordZ(rng), b; do b=wordZ(rng); while (b==a); return word(a)+" "+word(b); }
+    string location(){ return "Room "+to_string(100+locZ(rng)); }
+    static string dateOf(long long day){ int k=EventManager::keyFromDays(day); char b[16]; snprintf(b,sizeof b,"%02d-%02d-%04d",k%100,k/100%100,k/10000); return b; }
+    static string monthOf(long long day){ int k=EventManager::keyFromDays(day); char b[16]; snprintf(b,sizeof b,"%02d-%04d",k/100%100,k/10000); return b; }
+    void push(vector<Event>& v, long long day, int minute, string name, const char* type, string loc){
+        v.push_back(Event{0,move(name),dateOf(day),EventManager::fromMinutes(minute),type,move(loc)});
+    }
+    // Random days first, then the first day with room. Only a trace that
+    // outgrows the window gets an unclaimed (possibly conflicting) slot.
+    Event oneOff(){
+        long long day=pickDay(); int minute=slotOn(day,pickMinute());
+        for (int tries=0; minute<0 && tries<64; tries++){ day=pickDay(); minute=slotOn(day,pickMinute()); }
+        for (long long d=spec.firstDay; minute<0 && d<spec.firstDay+spec.days; d++){ day=d; minute=slotOn(day,pickMinute()); }
+        if (minute<0) minute=pickMinute();
+        return Event{0,title(),dateOf(day),EventManager::fromMinutes(minute),kTypes[typeZ(rng)],location()};
+    }
+    static string row(const Event& e){ return e.name+"|"+e.date+"|"+e.time+"|"+e.type+"|"+e.location; }
 
-    bool deleteByName(const string& name){
-        auto before = events.size();
-        events.erase(remove_if(events.begin(),events.end(),[&](const Event& e){return iequals(e.name,name);} ),events.end());
-        if (events.size()==before){ cout<<"No event with that name.\n"; return false; }
-        cout<<"Deleted.\n"; return true;
+public:
+    explicit WorkloadGen(const WorkloadSpec& s): spec(s), rng{s.seed}, typeZ(size(kTypes),s.zipf), locZ(s.locations,s.zipf),
+        wordZ(s.vocab,s.zipf), personZ(s.people,s.zipf) { spec.days=windowDays(s); }
+
+    // Days actually used: at least events/12, so every event finds a slot.
+    static int windowDays(const WorkloadSpec& s){ return (int)max<size_t>((size_t)s.days,(s.events+11)/12); }
+
+    // Vocabulary word of rank i; ranks past the base list get a numeric suffix.
+    static string word(size_t i){ return i<48 ? kWords[i] : kWords[i%48]+to_string(i/48); }
+
+    Catalogue catalogue(){
+        Catalogue c; vector<Event>& ev=c.events; const size_t n=spec.events;
+        ev.reserve(n);
+        const size_t burstEnd=(size_t)(n*spec.bursts), seriesEnd=burstEnd+(size_t)(n*spec.series);
+        // Conferences: 2-4 days, one venue, a 09:00 keynote then hourly talks
+        // from 10:00; slots already taken that day are skipped.
+        while (ev.size()<burstEnd){
+            long long first=pickDay(); int len=2+(int)rng.below(3); size_t perDay=4+rng.below(6);
+            string conf=word()+" Summit", venue="Expo Hall "+to_string(1+rng.below(5));
+            for (int d=0; d<len && ev.size()<burstEnd && first+d<spec.firstDay+spec.days; d++){
+                if (claim(first+d,9*60)) push(ev,first+d,9*60,conf+": Keynote","keynote",venue);
+                for (size_t k=1; k<perDay && ev.size()<burstEnd; k++)
+                    if (claim(first+d,(9+(int)k)*60)) push(ev,first+d,(9+(int)k)*60,conf+": "+title(),"talk",venue+" / Track "+to_string(1+rng.below(4)));
+            }
+        }
+        // Weekly series: same name, weekday, time and room for 4-52 weeks,
+        // minus the weeks where that slot is taken.
+        while (ev.size()<seriesEnd){
+            long long first=pickDay(); int minute=pickMinute(); size_t reps=4+rng.below(49);
+            string name="Weekly "+word()+" "+(rng.below(2) ? "Sync" : "Standup"), loc=location(); const char* type=kTypes[typeZ(rng)];
+            for (size_t r=0; r<reps && ev.size()<seriesEnd && first+7*(long long)r<spec.firstDay+spec.days; r++)
+                if (claim(first+7*(long long)r,minute)) push(ev,first+7*(long long)r,minute,name,type,loc);
+        }
+        while (ev.size()<n) ev.push_back(oneOff());
+        // Ids follow creation order, which has nothing to do with dates.
+        for (size_t i=ev.size(); i>1; i--) swap(ev[i-1],ev[rng.below(i)]);
+        for (size_t i=0;i<ev.size();i++) ev[i].id=(int)i+1;
+
+        if (spec.attendees>0){
+            for (size_t i=0;i<spec.people;i++)
+                c.people.push_back(string(kFirst[i%16])+"."+to_string(i)+"@"+kDomains[min<size_t>(7,(size_t)(-log(1-rng.unit())*1.5))]);
+            for (const Event& e: ev){
+                size_t k=(size_t)(-log(1-rng.unit())*spec.attendees);
+                for (size_t j=0;j<k;j++) c.registrations.push_back({e.id,c.people[personZ(rng)]});
+            }
+            sort(c.registrations.begin(),c.registrations.end());
+            c.registrations.erase(unique(c.registrations.begin(),c.registrations.end()),c.registrations.end());
+        }
+        return c;
+    }
+
+    static void writeCsv(ostream& os, const Catalogue& c){
+        os<<"id,name,date,time,type,location\n";
+        for (const Event& e: c.events) os<<e.id<<","<<e.name<<","<<e.date<<","<<e.time<<","<<e.type<<","<<e.location<<"\n";
     }
 
-    void dayView(const string& date){
-        vector<Event> list; for (const auto& e: events) if (e.date==date) list.push_back(e);
-        sort(list.begin(),list.end(),[](const Event&a,const Event&b){return toMinutes(a.time)<toMinutes(b.time);} );
-        if (list.empty()){ cout<<"No events on this date.\n"; return; }
-        printHeader(); for (const auto& e: list) printEvent(e);
+    // Same layout as EventManager::saveTo, so TenantHost and loadFrom read it.
+    static void writeSnapshot(ostream& os, const Catalogue& c){
+        os<<"EVTSNAP 1 "<<c.events.size()+1<<"\n";
+        for (const Event& e: c.events) os<<EventManager::encodeMutation({Mutation::Put,0,e})<<"\n";
+        for (const string& p: c.people) os<<'@'<<p<<"\n";
+        for (const auto& r: c.registrations) os<<'R'<<r.first<<'\t'<<r.second<<"\n";
     }
 
-    void todaysEvents(){ dayView(today()); }
+    static bool populate(EventManager& m, const Catalogue& c){ stringstream ss; writeSnapshot(ss,c); return m.loadFrom(ss); }
 
-    void listAll(){
-        if (events.empty()){ cout<<"No events.\n"; return; }
-        vector<Event> list=events;
-        auto ymd=[](const string& d){ return d.substr(6,4)+d.substr(3,2)+d.substr(0,2); };
-        sort(list.begin(),list.end(),[&](const Event&a,const Event&b){ if (a.date==b.date) return toMinutes(a.time)<toMinutes(b.time); return ymd(a.date)<ymd(b.date);} );
-        printHeader(); for (const auto& e: list) printEvent(e);
+    // Reads favour busy days (same skew as the catalogue) and popular words;
+    // writes add fresh events and delete by id or name.
+    void writeTrace(ostream& os, const Catalogue& c){
+        size_t nextId=c.events.size()+1;
+        for (size_t i=0;i<spec.ops;i++){
+            if (rng.unit()<spec.writes){
+                double u=rng.unit();
+                if (u<0.7 || c.events.empty()){ os<<"ADD "<<row(oneOff())<<"\n"; nextId++; }
+                else if (u<0.9) os<<"DEL "<<1+rng.below(nextId-1)<<"\n";
+                else os<<"DELNAME "<<c.events[rng.below(c.events.size())].name<<"\n";
+                continue;
+            }
+            double u=rng.unit();
+            if (u<0.40) os<<"DAY "<<dateOf(pickDay())<<"\n";
+            else if (u<0.60) os<<"SEARCH "<<word()<<"\n";
+            else if (u<0.75) os<<"WEEK "<<dateOf(pickDay())<<"\n";
+            else if (u<0.85) os<<"MONTH "<<monthOf(pickDay())<<"\n";
+            else if (u<0.93) os<<"TODAY\n";
+            else if (u<0.98) os<<"STATS\n";
+            else os<<"LIST\n";
+        }
     }
+};
 
-    void search(const string& keyword){
-        vector<Event> list; for (const auto& e: events){ if (icontains(e.name,keyword) || icontains(e.type,keyword)) list.push_back(e); }
-        if (list.empty()){ cout<<"No matches.\n"; return; }
-        sort(list.begin(),list.end(),[](const Event&a,const Event&b){return a.id<b.id;});
-        printHeader(); for (const auto& e: list) printEvent(e);
+static int generateMain(int argc, char** argv){
+    WorkloadSpec spec; string format="csv", outPath;
+    for (int i=2;i<argc;i++){
+        string a=argv[i]; size_t eq=a.find('=');
+        string key=a.substr(0,eq), value = eq==string::npos ? "" : a.substr(eq+1);
+        if (key=="format" && (value=="csv" || value=="snapshot" || value=="trace")) format=value;
+        else if (key=="out" && !value.empty()) outPath=value;
+        else if (eq==string::npos || !spec.set(key,value)){
+            cerr<<"usage: --generate [format=csv|snapshot|trace] [out=FILE] [seed= events= start=DD-MM-YYYY days= weekend=\n"
+                  "        zipf= locations= vocab= bursts= series= people= attendees= ops= writes=]\n";
+            return 2;
+        }
     }
+    ofstream file; if (!outPath.empty()){ file.open(outPath); if (!file){ cerr<<"Cannot write "<<outPath<<"\n"; return 1; } }
+    ostream& os = outPath.empty() ? cout : file;
+    WorkloadGen gen(spec); Catalogue c=gen.catalogue();
+    if (format=="csv") WorkloadGen::writeCsv(os,c);
+    else if (format=="snapshot") WorkloadGen::writeSnapshot(os,c);
+    else gen.writeTrace(os,c);
+    os.flush();
+    return os ? 0 : 1;
+}
 
-    void statistics(){
-        cout<<"Total events: "<<events.size()<<"\n";
-        map<string,int> byType, byDate; for (const auto& e: events){ byType[e.type]++; byDate[e.date]++; }
-        cout<<"By type:\n"; for (auto&p: byType) cout<<"  "<<p.first<<": "<<p.second<<"\n";
-        vector<pair<string,int>> v(byDate.begin(),byDate.end());
-        sort(v.begin(),v.end(),[](auto&a,auto&b){return a.second>b.second;});
-        cout<<"Top 5 dates by count:\n"; for(size_t i=0;i<v.size()&&i<5;i++) cout<<"  "<<v[i].first<<": "<<v[i].second<<"\n";
+// ------------------- Benchmarks -------------------
+// --bench [MIN-MAX] times the core EventManager operations on WorkloadGen
+// calendars (three years, default skew) of 10^MIN..10^MAX events (default
+// 3-6; 7 needs ~5 GB). Every call is timed on its own for the percentiles;
+// whatever the ops print goes to a discarding stream. Allocations are
+// counted only in builds with -DEVENT_BENCH_ALLOCS, which replace the global
+// operator new below; other builds keep the standard allocator and print
+// "-" for allocs/op.
+
+#ifdef EVENT_BENCH_ALLOCS
+static const bool kCountAllocs = true;
+static thread_local uint64_t tlsAllocs = 0;
+
+void* operator new(size_t n){ ++tlsAllocs; if (void* p=malloc(n?n:1)) return p; throw bad_alloc(); }
+// Out of line so GCC doesn't pair an inlined free() with operator new and warn.
+[[gnu::noinline]] void operator delete(void* p) noexcept { free(p); }
+[[gnu::noinline]] void operator delete(void* p, size_t) noexcept { free(p); }
+#else
+static const bool kCountAllocs = false;
+static const uint64_t tlsAllocs = 0;
+#endif
+
+struct NullBuf : streambuf {
+    int overflow(int c) override { return c; }
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+};
+
+// Hardware counters for --bench --counters: cycles, instructions, L1d read
+// misses, last-level cache misses and branch misses, user space only. Each
+// counter has its own fd and is scaled if the kernel multiplexes it.
+// Counters the kernel or VM won't provide read as unavailable; with none at
+// all the bench reports why and runs on wall time alone.
+class PerfCounters {
+public:
+    enum { Cycles, Instructions, L1dMisses, LlcMisses, BranchMisses, kCount };
+    struct Sample { double v[kCount] = {}; bool ok[kCount] = {}; };
+    string error;                              // why nothing could be opened
+
+#ifdef __linux__
+private:
+    int fds[kCount] = {-1,-1,-1,-1,-1};
+
+    static int open(uint32_t type, uint64_t config){
+        perf_event_attr a{}; a.size=sizeof a; a.type=type; a.config=config;
+        a.disabled=1; a.exclude_kernel=1; a.exclude_hv=1;
+        a.read_format=PERF_FORMAT_TOTAL_TIME_ENABLED|PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return (int)syscall(SYS_perf_event_open,&a,0,-1,-1,0);
     }
 
-    // ------------------- Reminders (Simulated) -------------------
-    void loadAttendeesFromPaste(){
-        cout<<"Paste emails (comma/space/newline separated). End with a blank line.\n";
-        attendeeEmails.clear();
-        string line, all;
-        while (true){
-            getline(cin,line);
-            if (line.size()==0) break; all += line + ' ';
+public:
+    PerfCounters() = default;
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+    ~PerfCounters(){ for (int fd: fds) if (fd>=0) close(fd); }
+
+    bool openAll(){
+        const uint64_t l1dReadMiss = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ<<8) | (PERF_COUNT_HW_CACHE_RESULT_MISS<<16);
+        const pair<uint32_t,uint64_t> cfg[kCount] = {
+            {PERF_TYPE_HARDWARE,PERF_COUNT_HW_CPU_CYCLES}, {PERF_TYPE_HARDWARE,PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HW_CACHE,l1dReadMiss}, {PERF_TYPE_HARDWARE,PERF_COUNT_HW_CACHE_MISSES},
+            {PERF_TYPE_HARDWARE,PERF_COUNT_HW_BRANCH_MISSES}};
+        bool any=false; int firstErr=0;
+        for (int i=0;i<kCount;i++){ fds[i]=open(cfg[i].first,cfg[i].second); if (fds[i]>=0) any=true; else if (!firstErr) firstErr=errno; }
+        if (!any){
+            error = string("perf_event_open: ")+strerror(firstErr);
+            if (firstErr==EACCES || firstErr==EPERM) error += " (see /proc/sys/kernel/perf_event_paranoid)";
+            else if (firstErr==ENOENT || firstErr==EOPNOTSUPP) error += " (no hardware PMU, e.g. inside a VM)";
         }
-        stringstream ss(all); string token;
-        auto isEmail=[&](const string&s){ return s.find('@')!=string::npos && s.find('.')!=string::npos; };
-        while (ss>>token){ if (token.back()==','||token.back()==';') token.pop_back(); if (isEmail(token)) attendeeEmails.push_back(token); }
-        cout<<"Loaded "<<attendeeEmails.size()<<" attendee emails.\n";
+        return any;
     }
 
-    void sendReminderForDate(const string& date){
-        vector<Event> list; for (const auto& e: events) if (e.date==date) list.push_back(e);
-        if (list.empty()){ cout<<"No events on this date.\n"; return; }
-        sort(list.begin(),list.end(),[](const Event&a,const Event&b){return toMinutes(a.time)<toMinutes(b.time);} );
-        ostringstream body; body<<"Upcoming events on "<<date<<":\n\n";
-        for (const auto& e: list) body<<"- "<<e.time<<" | "<<e.name<<" ("<<e.type<<") @ "<<(e.location.empty()?"TBA":e.location)<<"\n";
-        if (attendeeEmails.empty()){
-            cout<<"No attendee emails loaded. Choose 'Load attendees' first.\n"; return;
+    void start(){ for (int fd: fds) if (fd>=0){ ioctl(fd,PERF_EVENT_IOC_RESET,0); ioctl(fd,PERF_EVENT_IOC_ENABLE,0); } }
+
+    Sample stop(){
+        Sample s;
+        for (int fd: fds) if (fd>=0) ioctl(fd,PERF_EVENT_IOC_DISABLE,0);
+        for (int i=0;i<kCount;i++){
+            uint64_t r[3];                     // value, time enabled, time running
+            if (fds[i]<0 || read(fds[i],r,sizeof r)!=(ssize_t)sizeof r || !r[2]) continue;
+            s.v[i] = r[2]<r[1] ? (double)r[0]*r[1]/r[2] : (double)r[0]; s.ok[i]=true;
         }
-        cout<<"[SIMULATED EMAIL SEND] To "<<attendeeEmails.size()<<" recipients.\nSubject: Reminder: Events on "<<date<<"\n\n"<<body.str();
-        cout<<"(Emails not actually sent in online IDE.)\n";
+        return s;
     }
+#else
+    bool openAll(){ error="hardware counters need Linux perf_event_open"; return false; }
+    void start(){}
+    Sample stop(){ return {}; }
+#endif
+};
 
-    // ------------------- Suggestions -------------------
-    void suggestSlots(const string& date, int duration=60){
-        cout<<"Suggested available slots on "<<date<<":\n";
-        vector<pair<int,int>> occ; for (const auto& e: events) if (e.date==date){ int s=toMinutes(e.time); occ.push_back({s,s+60}); }
-        sort(occ.begin(),occ.end());
-        int start=8*60, end=20*60, shown=0;
-        for (int t=start; t+duration<=end && shown<5; t+=30){ bool clash=false; for (auto& iv: occ){ if (!(t+duration<=iv.first || t>=iv.second)) { clash=true; break; } } if(!clash){ cout<<"  - "<<fromMinutes(t)<<" to "<<fromMinutes(t+duration)<<"\n"; shown++; } }
-        if (!shown) cout<<"  (No free 1-hour slots found in working window)\n";
+// Benchmark baselines: per (op, events) the mean time per call of each
+// repetition. Saved as JSON by --save and read back by --compare; the reader
+// only understands the shape the writer produces.
+struct BenchSeries { string op; size_t events = 0; vector<double> ns; };
+
+// Two-sided 95% Student t quantile; exact table to 30 degrees of freedom,
+// Cornish-Fisher expansion beyond.
+static double tCritical95(double df){
+    static const double t[30] = {12.706,4.303,3.182,2.776,2.571,2.447,2.365,2.306,2.262,2.228,2.201,2.179,2.160,2.145,2.131,
+                                 2.120,2.110,2.101,2.093,2.086,2.080,2.074,2.069,2.064,2.060,2.056,2.052,2.048,2.045,2.042};
+    if (df<1) return t[0];
+    if (df<30) return t[(int)df-1];
+    const double z=1.959964;
+    return z + (z*z*z+z)/(4*df) + (5*pow(z,5)+16*z*z*z+3*z)/(96*df*df);
+}
+
+static void meanSd(const vector<double>& v, double& mean, double& sd){
+    mean=0; for (double x: v) mean+=x; mean/=v.size();
+    double ss=0; for (double x: v) ss+=(x-mean)*(x-mean);
+    sd = v.size()>1 ? sqrt(ss/(v.size()-1)) : 0;
+}
+
+static bool writeBaseline(const string& path, const vector<BenchSeries>& series, int reps){
+    ofstream f(path); if (!f) return false;
+    f<<"{\"version\":1,\"reps\":"<<reps<<",\"results\":[";
+    char b[32];
+    for (size_t i=0;i<series.size();i++){
+        f<<(i?",":"")<<"\n  {\"op\":\""<<series[i].op<<"\",\"events\":"<<series[i].events<<",\"ns\":[";
+        for (size_t j=0;j<series[i].ns.size();j++){ snprintf(b,sizeof b,"%.1f",series[i].ns[j]); f<<(j?",":"")<<b; }
+        f<<"]}";
     }
+    f<<"\n]}\n";
+    return (bool)f;
+}
 
-    // ------------------- Snapshot (manual persistence aid) -------------------
-    void exportSnapshotCSV(){
-        cout<<"id,name,date,time,type,location\n";
-        for (const auto& e: events){
-            cout<<e.id<<","<<e.name<<","<<e.date<<","<<e.time<<","<<e.type<<","<<e.location<<"\n";
+static bool readBaseline(const string& path, vector<BenchSeries>& out, string& err){
+    ifstream f(path); if (!f){ err="cannot open "+path; return false; }
+    string text((istreambuf_iterator<char>(f)),istreambuf_iterator<char>());
+    size_t pos=text.find("\"results\"");
+    if (pos==string::npos){ err=path+": no \"results\" array"; return false; }
+    auto field=[&](size_t from, size_t end, const char* key) -> size_t {
+        size_t k=text.find(string("\"")+key+"\"",from);
+        if (k==string::npos || k>end) return string::npos;
+        k=text.find(':',k); return k==string::npos || k>end ? string::npos : k+1;
+    };
+    while ((pos=text.find('{',pos))!=string::npos){
+        size_t end=text.find('}',pos); if (end==string::npos) break;
+        size_t o=field(pos,end,"op"), e=field(pos,end,"events"), n=field(pos,end,"ns");
+        if (o==string::npos || e==string::npos || n==string::npos){ err=path+": malformed result near byte "+to_string(pos); return false; }
+        BenchSeries s;
+        o=text.find('"',o); size_t oe=text.find('"',o+1); s.op=text.substr(o+1,oe-o-1);
+        s.events=strtoull(text.c_str()+e,nullptr,10);
+        size_t a=text.find('[',n), z=text.find(']',n);
+        for (const char* c=text.c_str()+a+1; c<text.c_str()+z; ){
+            char* next; double v=strtod(c,&next);
+            if (next==c){ c++; continue; }
+            s.ns.push_back(v); c=next;
         }
-        cout<<"(Copy the above lines to save. Import with the menu option.)\n";
+        if (s.ns.empty()){ err=path+": no samples for "+s.op; return false; }
+        out.push_back(move(s)); pos=end+1;
     }
+    return true;
+}
 
-    void importSnapshotCSV(){
-        cout<<"Paste CSV lines (header optional). End with a blank line.\n";
-        string line; vector<Event> temp; int maxId=0; bool first=true;
-        while (true){
-            getline(cin,line); if (line.size()==0) break; if (line.find(",")==string::npos) continue;
-            if (first && toLower(line).find("id,name,date,time,type,location")!=string::npos){ first=false; continue; }
-            first=false;
-            stringstream ss(line); string tok; Event e; int col=0;
-            while (getline(ss,tok,',')){
-                switch(col){
-                    case 0: if (!tok.empty()) e.id = stoi(tok); break;
-                    case 1: e.name = tok; break;
-                    case 2: e.date = tok; break;
-                    case 3: e.time = tok; break;
-                    case 4: e.type = tok; break;
-                    case 5: e.location = tok; break;
+class Bench {
+    static const int kWindowDays = 1096;           // three years
+
+    SeededRng rng{1};
+    PerfCounters* counters = nullptr;          // set when --counters opened any
+    vector<BenchSeries> series;                // mean ns/call per repetition
+    NullBuf nullBuf;
+    ostream sink{&nullBuf};
+
+    static string dateOf(long long day){ int k=EventManager::keyFromDays(day); char b[16]; snprintf(b,sizeof b,"%02d-%02d-%04d",k%100,k/100%100,k/10000); return b; }
+    static string timeOf(int minute){ return EventManager::fromMinutes(minute); }
+
+    // Whole-store operations repeat fewer times as the store grows.
+    static size_t scanIters(size_t n){ return max<size_t>(3,min<size_t>(1000,2000000/n)); }
+
+    template<class Fn> void run(const char* op, size_t events, size_t iters, Fn fn){
+        vector<uint64_t> ns(iters);
+        ostream* saved=tlsOut; tlsOut=&sink;
+        uint64_t allocs0=tlsAllocs; auto t0=chrono::steady_clock::now();
+        if (counters) counters->start();
+        for (size_t i=0;i<iters;i++){
+            auto s=chrono::steady_clock::now(); fn(i);
+            ns[i]=(uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now()-s).count();
+        }
+        PerfCounters::Sample hw; if (counters) hw=counters->stop();
+        double secs=chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+        uint64_t allocs=tlsAllocs-allocs0; tlsOut=saved;
+        record(op,events,secs*1e9/iters);
+        sort(ns.begin(),ns.end());
+        auto pct=[&](int p){ return fmtNanos((double)ns[min(iters-1,iters*p/100)]); };
+        char rate[32]; snprintf(rate,sizeof rate,iters/secs<100 ? "%.2f" : "%.0f",iters/secs);
+        char perOp[32] = "-"; if (kCountAllocs) snprintf(perOp,sizeof perOp,"%.1f",(double)allocs/iters);
+        cout<<left<<setw(18)<<op<<right<<setw(10)<<events<<setw(8)<<iters<<setw(12)<<rate
+            <<setw(10)<<pct(50)<<setw(10)<<pct(90)<<setw(10)<<pct(99)<<setw(10)<<fmtNanos((double)ns.back())<<setw(11)<<perOp<<"\n";
+        if (counters){
+            // Per call, including the two clock reads that time it.
+            static const char* names[PerfCounters::kCount] = {"cycles","instr","L1d-miss","LLC-miss","br-miss"};
+            string line="    per op:"; char b[48];
+            for (int c=0;c<PerfCounters::kCount;c++){
+                if (hw.ok[c]) snprintf(b,sizeof b," %s %.1f",names[c],hw.v[c]/iters); else snprintf(b,sizeof b," %s n/a",names[c]);
+                line+=b;
+                if (c==PerfCounters::Instructions && hw.ok[PerfCounters::Cycles] && hw.ok[c] && hw.v[PerfCounters::Cycles]>0){ snprintf(b,sizeof b," (IPC %.2f)",hw.v[c]/hw.v[PerfCounters::Cycles]); line+=b; }
+                line+= c+1<PerfCounters::kCount ? "," : "";
+            }
+            cout<<line<<"\n";
+        }
+    }
+
+    void record(const char* op, size_t events, double ns){
+        for (auto& s: series) if (s.events==events && s.op==op){ s.ns.push_back(ns); return; }
+        series.push_back({op,events,{ns}});
+    }
+
+    static const BenchSeries* find(const vector<BenchSeries>& v, const BenchSeries& k){
+        for (auto& s: v) if (s.events==k.events && s.op==k.op) return &s;
+        return nullptr;
+    }
+
+    void summarize(int reps) const {
+        cout<<"\nAcross "<<reps<<" repetitions (mean time per call, 95% confidence interval)\n";
+        cout<<left<<setw(18)<<"op"<<right<<setw(10)<<"events"<<setw(12)<<"mean"<<setw(12)<<"+/-"<<setw(9)<<"rel"<<"\n";
+        for (auto& s: series){
+            double mean,sd; meanSd(s.ns,mean,sd);
+            double half = tCritical95((double)s.ns.size()-1)*sd/sqrt((double)s.ns.size());
+            char rel[16]; snprintf(rel,sizeof rel,"%.1f%%",mean>0 ? 100*half/mean : 0.0);
+            cout<<left<<setw(18)<<s.op<<right<<setw(10)<<s.events<<setw(12)<<fmtNanos(mean)<<setw(12)<<fmtNanos(half)<<setw(9)<<rel<<"\n";
+        }
+    }
+
+public:
+    // Welch's t-test per operation: a change counts only if it exceeds the
+    // threshold and is significant at 95%. With a single repetition on
+    // either side there is no variance, so the threshold alone decides.
+    // Returns the number of regressions.
+    int compare(const vector<BenchSeries>& base, double thresholdPct) const {
+        cout<<"\nAgainst baseline (threshold "<<thresholdPct<<"%)\n";
+        cout<<left<<setw(18)<<"op"<<right<<setw(10)<<"events"<<setw(12)<<"baseline"<<setw(12)<<"now"<<setw(9)<<"change"<<"  verdict\n";
+        int regressions=0;
+        for (auto& s: series){
+            const BenchSeries* b=find(base,s);
+            if (!b){ cout<<left<<setw(18)<<s.op<<right<<setw(10)<<s.events<<"  not in baseline\n"; continue; }
+            double m1,sd1,m0,sd0; meanSd(s.ns,m1,sd1); meanSd(b->ns,m0,sd0);
+            double change = m0>0 ? 100*(m1/m0-1) : 0;
+            bool significant=true;
+            if (s.ns.size()>1 && b->ns.size()>1){
+                double v1=sd1*sd1/s.ns.size(), v0=sd0*sd0/b->ns.size();
+                if (v1+v0>0){
+                    double t=fabs(m1-m0)/sqrt(v1+v0);
+                    double df=(v1+v0)*(v1+v0)/(v1*v1/(s.ns.size()-1)+v0*v0/(b->ns.size()-1));
+                    significant = t>tCritical95(df);
                 }
-                col++;
             }
-            if (e.id==0 || e.name.empty() || !isValidDate(e.date) || !isValidTime(e.time)) continue;
-            temp.push_back(e); maxId=max(maxId,e.id);
+            const char* verdict = "ok";
+            if (fabs(change)>thresholdPct) verdict = !significant ? "ok (noise)" : change>0 ? "REGRESSION" : "faster";
+            if (!strcmp(verdict,"REGRESSION")) regressions++;
+            char pct[16]; snprintf(pct,sizeof pct,"%+.1f%%",change);
+            cout<<left<<setw(18)<<s.op<<right<<setw(10)<<s.events<<setw(12)<<fmtNanos(m0)<<setw(12)<<fmtNanos(m1)<<setw(9)<<pct<<"  "<<verdict<<"\n";
+        }
+        for (auto& b: base) if (!find(series,b)) cout<<left<<setw(18)<<b.op<<right<<setw(10)<<b.events<<"  not measured in this run\n";
+        cout<<(regressions ? to_string(regressions)+" regression(s) above threshold.\n" : string("No regressions above threshold.\n"));
+        return regressions;
+    }
+
+    void sizeRun(size_t n){
+        EventManager m; vector<Event> probes;
+        rng=SeededRng{1};                      // every repetition sees the same workload
+        WorkloadSpec spec; spec.events=n; spec.days=kWindowDays; spec.attendees=0;
+        {
+            Catalogue c=WorkloadGen(spec).catalogue();
+            for (size_t i=0;i<min<size_t>(n,1000);i++) probes.push_back(c.events[rng.below(n)]);
+            m.restoreCheckpoint(c.events,(int)n+1);
+        }
+        const size_t kPoint=20000, scans=scanIters(n);
+        auto probe=[&](size_t i) -> const Event& { return probes[i%probes.size()]; };
+
+        run("isDuplicate",n,kPoint,[&](size_t i){
+            const Event& e=probe(i);
+            m.isDuplicate(i%2 ? e.name : "No such event",e.date,e.time);
+        });
+        run("addEvent/conflict",n,kPoint,[&](size_t i){
+            const Event& e=probe(i);
+            m.addEvent("Clash",e.date,timeOf(EventManager::toMinutes(e.time)+(int)(i%59)),"meeting","",false);
+        });
+        run("dayView",n,kPoint,[&](size_t i){ m.dayView(probe(i).date); });
+        run("suggestSlots",n,kPoint,[&](size_t i){ m.suggestSlots(probe(i).date); });
+        run("search",n,scans,[&](size_t i){ m.search(WorkloadGen::word(i%16)); });
+        run("listAll",n,scans,[&](size_t){ m.listAll(); });
+        run("statistics",n,scans,[&](size_t){ m.statistics(); });
+
+        ostringstream csv; { ostream* saved=tlsOut; tlsOut=&csv; m.exportSnapshotCSV(); tlsOut=saved; }
+        csv<<"\n";
+        const string text=csv.str();
+        run("exportCSV",n,scans,[&](size_t){ m.exportSnapshotCSV(); });
+        run("importCSV",n,scans,[&](size_t){
+            istringstream is(text); streambuf* saved=cin.rdbuf(is.rdbuf());
+            m.importSnapshotCSV(); cin.rdbuf(saved);
+        });
+        // Accepted inserts: hourly slots on otherwise empty days after the window.
+        run("addEvent",n,kPoint,[&](size_t i){
+            m.addEvent(WorkloadGen::word(i%48)+" "+to_string(i),dateOf(spec.firstDay+WorkloadGen::windowDays(spec)+(long long)(i/24)),timeOf((int)(i%24)*60),"meeting","",false);
+        });
+    }
+
+    int main(int minExp, int maxExp, bool wantCounters, int reps){
+        PerfCounters hw;
+        if (wantCounters){
+            if (hw.openAll()) counters=&hw;
+            else cout<<"Hardware counters unavailable: "<<hw.error<<"; reporting wall time only.\n";
         }
-        if (temp.empty()){ cout<<"Nothing imported.\n"; return; }
-        events = temp; nextId = maxId+1; cout<<"Imported "<<events.size()<<" events. Next ID: "<<nextId<<"\n";
+        cout<<"Benchmark: 10^"<<minExp<<" .. 10^"<<maxExp<<" events, fixed seed\n";
+        cout<<left<<setw(18)<<"op"<<right<<setw(10)<<"events"<<setw(8)<<"iters"<<setw(12)<<"ops/s"
+            <<setw(10)<<"p50"<<setw(10)<<"p90"<<setw(10)<<"p99"<<setw(10)<<"max"<<setw(11)<<"allocs/op"<<"\n";
+        for (int e=minExp;e<=maxExp;e++){ size_t n=1; for (int i=0;i<e;i++) n*=10; for (int r=0;r<reps;r++) sizeRun(n); }
+        if (reps>1) summarize(reps);
+        return 0;
     }
+
+    const vector<BenchSeries>& results() const { return series; }
 };
 
+// Exit status 1 when --compare finds a regression, so a build can gate on it.
+static int benchMain(int argc, char** argv){
+    int lo=3, hi=6, reps=0; bool counters=false; double threshold=5;
+    string savePath, comparePath;
+    auto usage=[]{ cerr<<"usage: --bench [MIN-MAX] [--counters] [--reps N] [--save FILE] [--compare FILE] [--threshold PCT]\n"
+                         "       MIN-MAX are powers of ten, e.g. 3-7\n"; return 2; };
+    for (int i=2;i<argc;i++){
+        string r=argv[i];
+        if (r=="--counters"){ counters=true; continue; }
+        if (r=="--reps" || r=="--save" || r=="--compare" || r=="--threshold"){
+            if (i+1>=argc) return usage();
+            string v=argv[++i];
+            try {
+                if (r=="--reps"){ reps=stoi(v); if (reps<1 || reps>100) return usage(); }
+                else if (r=="--threshold"){ threshold=stod(v); if (threshold<0) return usage(); }
+                else (r=="--save" ? savePath : comparePath)=v;
+            } catch (...) { return usage(); }
+            continue;
+        }
+        size_t dash=r.find('-');
+        try { lo=stoi(r.substr(0,dash)); hi = dash==string::npos ? lo : stoi(r.substr(dash+1)); } catch (...) { lo=-1; }
+        if (lo<1 || hi<lo || hi>8) return usage();
+    }
+    // A baseline is only worth comparing with a spread; default to five runs.
+    if (!reps) reps = savePath.empty() && comparePath.empty() ? 1 : 5;
+    vector<BenchSeries> base; string err;
+    if (!comparePath.empty() && !readBaseline(comparePath,base,err)){ cerr<<err<<"\n"; return 2; }
+    Bench b; b.main(lo,hi,counters,reps);
+    if (!savePath.empty()){
+        if (!writeBaseline(savePath,b.results(),reps)){ cerr<<"Cannot write "<<savePath<<"\n"; return 2; }
+        cout<<"Baseline saved to "<<savePath<<".\n";
+    }
+    return !comparePath.empty() && b.compare(base,threshold)>0 ? 1 : 0;
+}
+
 // ------------------- CLI -------------------
 
+// Admin rights are per organization: logging in grants admin on the current
+// org only, and switching orgs re-evaluates isAdmin.
 static bool isAdmin = false;
+static string currentOrg = "default";
+static set<string> adminOrgs;
+static OutputFormat outputFormat = OutputFormat::Table;   // for options 1-4
 
 void adminLogin(){
     string user, pass; cout<<"\n== Admin Login ==\nUsername: "; getline(cin,user); cout<<"Password: "; getline(cin,pass);
-    if ((user=="admin" || user=="ACMadmin") && pass=="admin123") { isAdmin=true; cout<<"Logged in as admin.\n"; }
+    if ((user=="admin" || user=="ACMadmin") && pass=="admin123") { isAdmin=true; adminOrgs.insert(currentOrg); cout<<"Logged in as admin of '"<<currentOrg<<"'.\n"; }
     else cout<<"Invalid credentials. Continuing as viewer.\n";
 }
 
 void menu(){
-    cout<<"\n====== Smart Event Manager ======\n";
+    cout<<"\n====== Smart Event Manager ["<<currentOrg<<"] ======\n";
     cout<<"1) List all events\n";
     cout<<"2) Day view (pick date)\n";
     cout<<"3) Today's events\n";
@@ -324,33 +4426,406 @@ void menu(){
         cout<<"11) Statistics (admin)\n";
         cout<<"12) Export snapshot CSV (admin)\n";
         cout<<"13) Import snapshot CSV (admin)\n";
+        cout<<"14) Replication status (admin)\n";
+        cout<<"15) Watch date/range/location (admin)\n";
+        cout<<"16) Stop watching by ID (admin)\n";
+        cout<<"18) Memory report by tenant and subsystem (admin)\n";
+        cout<<"19) Reminder delivery status (admin)\n";
+        cout<<"20) Automatic reminder offsets (admin)\n";
+        cout<<"21) Register attendees for an event (admin)\n";
+        cout<<"22) Send digest reminders for a date range (admin)\n";
+        cout<<"23) Edit reminder template (admin)\n";
+        cout<<"27) Operation latency (admin)\n";
+        cout<<"28) Dump trace spans (admin)\n";
     }
+    cout<<"17) Switch organization\n";
+    cout<<"24) Output format (now: "<<formatName(outputFormat)<<")\n";
+    cout<<"25) Week view\n26) Month view\n";
     cout<<"0) Exit\nSelect: ";
 }
 
-int main(){
-    EventManager mgr;
+void replicationStatus(const EventManager& mgr, const Follower& standby, const Follower& replica){
+    cout<<"Leader LSN: "<<mgr.currentLsn()<<" (retained log: "<<mgr.logSize()<<" records)\n";
+    for (const Follower* f: {&standby,&replica}){
+        cout<<(f==&standby ? "Hot standby:  " : "Read replica: ");
+        if (!f->running()){ cout<<"not running\n"; continue; }
+        cout<<"pid "<<f->processId()<<", ";
+        if (f->following(mgr)) cout<<"shipped "<<f->shippedLsn()<<", lag "<<f->lag(mgr);
+        else cout<<"awaiting checkpoint";
+        cout<<", checkpoints "<<f->checkpointCount()<<"\n";
+    }
+}
+
+// --follow worker: one partition of a --cluster router (see Cluster).
+static int clusterWorkerMain(){
+    map<string,unique_ptr<EventManager>> tenants;
+    auto store=[&](const string& org) -> EventManager& { auto& p=tenants[org]; if (!p) p=make_unique<EventManager>(); return *p; };
+    auto rows=[](const vector<Event>& list){ string r; for (const auto& e: list){ r+=EventManager::encodeMutation({Mutation::Put,0,e}); r+='\n'; } return r; };
+    string line, row;
+    while (getline(cin,line)){
+        if (line=="BYE") return 0;
+        vector<string> f=splitEscaped(line);
+        const string& op=f[0]; string body;
+        ostringstream buf; tlsOut=&buf;
+        try {
+            if (op=="A" && f.size()==8){
+                bool ok=store(f[1]).addEventWithId(stoi(f[2]),f[3],f[4],f[5],f[6],f[7]);
+                body=(ok ? "1\n" : "0\n")+buf.str();
+            } else if ((op=="B" || op=="P") && f.size()==3){
+                EventManager& m=store(f[1]); size_t n=stoul(f[2]), done=0;
+                for (size_t i=0; i<n && getline(cin,row); i++){
+                    if (op=="P"){ Mutation mu; if (EventManager::decodeMutation(row,mu)){ m.applyMutation(mu); done++; } continue; }
+                    auto r=splitEscaped(row);
+                    if (r.size()==6 && m.addEventWithId(stoi(r[0]),r[1],r[2],r[3],r[4],r[5],false)) done++;
+                }
+                body=to_string(done)+"\n";
+            } else if (op=="Q" && f.size()==3){ runViewerRequest(store(f[1]),f[2]); body=buf.str(); }
+            else if (op=="L" && f.size()==2) body=rows(store(f[1]).chronological());
+            else if (op=="S" && f.size()==3) body=rows(store(f[1]).matching(f[2]));
+            else if (op=="R" && f.size()==4) body=rows(store(f[1]).between(stoi(f[2]),stoi(f[3])));
+            else if (op=="E" && f.size()==3) body=store(f[1]).deleteById(stoi(f[2])) ? "1\n" : "0\n";
+            else if (op=="X" && f.size()==3) body=store(f[1]).deleteByName(f[2]) ? "1\n" : "0\n";
+            else if (op=="K"){ for (const auto& t: tenants) for (const auto& d: t.second->dayCounts()) body+=escapeField(t.first)+'\t'+d.first+'\t'+to_string(d.second)+'\n'; }
+            else if (op=="T" && f.size()>=3){
+                set<string> days(f.begin()+2,f.end());
+                body=rows(store(f[1]).extractIf([&](const Event& e){ return days.count(e.date)>0; }));
+            } else if (op=="N"){ size_t n=0; for (const auto& t: tenants) n+=t.second->size(); body=to_string(tenants.size())+" "+to_string(n)+"\n"; }
+        } catch (...) { body.clear(); }
+        tlsOut=nullptr;
+        cout<<body.size()<<'\n'<<body<<flush;
+    }
+    return 0;
+}
+
+// --follow standby|replica|worker: the child end of a ChildLink.
+int followerMain(int argc, char** argv){
+    string role = argc>2 ? argv[2] : "";
+    if (role=="worker") return clusterWorkerMain();
+    if (role!="standby" && role!="replica"){ cerr<<"usage: --follow standby|replica|worker (started by the CLI or --cluster)\n"; return 2; }
+    const char* spill = getenv("EVENT_SPILL_DIR");
+    auto store = make_unique<EventManager>(); string org, line;
+    while (getline(cin,line)){
+        if (line=="BYE") return 0;
+        if (line.compare(0,2,"C ")==0){
+            stringstream snap; string row;
+            while (getline(cin,row) && row!=".") snap<<row<<'\n';
+            auto fresh = make_unique<EventManager>();
+            if (!fresh->loadFrom(snap)){ cerr<<role<<": unreadable checkpoint for '"<<line.substr(2)<<"'\n"; return 1; }
+            store=move(fresh); org=line.substr(2);
+        } else if (line.compare(0,2,"M ")==0){
+            Mutation m; if (EventManager::decodeMutation(line.substr(2),m)) store->applyMutation(m);
+        } else if (line.compare(0,2,"Q ")==0){
+            ostringstream buf; tlsOut=&buf;
+            runViewerRequest(*store,line.substr(2));
+            tlsOut=nullptr;
+            cout<<buf.str().size()<<'\n'<<buf.str()<<flush;
+        }
+    }
+    // The leader went away without BYE: keep the calendar it was serving.
+    if (role=="standby" && !org.empty()){
+        string path=TenantHost::spillFile(spill ? spill : ".",org);
+        if (TenantHost::writeFile(*store,path)) cerr<<"standby: leader lost; saved '"<<org<<"' to "<<path<<"\n";
+        else cerr<<"standby: leader lost; cannot write "<<path<<"\n";
+    }
+    return 0;
+}
+
+void watchScope(EventManager& mgr){
+    string from,to,loc; cout<<"From date (DD-MM-YYYY): "; getline(cin,from);
+    if (!EventManager::isValidDate(from)){ cout<<"Invalid date.\n"; return; }
+    cout<<"To date (blank = same day): "; getline(cin,to); if (to.empty()) to=from;
+    if (!EventManager::isValidDate(to) || EventManager::dayKey(to)<EventManager::dayKey(from)){ cout<<"Invalid date range.\n"; return; }
+    cout<<"Location (blank = any): "; getline(cin,loc);
+    int id = mgr.subscribe(from,to,loc,[](const ChangeNote& n){
+        static const char* kinds[] = {"Added","Updated","Removed"};
+        cout<<"[WATCH #"<<n.subId<<"] "<<kinds[n.kind]<<": "<<n.e.id<<" "<<n.e.name<<" "<<n.e.date<<" "<<n.e.time<<" @ "<<(n.e.location.empty()?"TBA":n.e.location)<<"\n";
+    });
+    cout<<"Watching as #"<<id<<".\n";
+}
+
+// "--workers 8,1,1" style triples for read,write,bulk lanes.
+static bool parseLaneTriple(const string& s, int (&v)[kLaneCount]){
+    stringstream ss(s); string tok; int i=0;
+    while (getline(ss,tok,',')){ if (i>=kLaneCount || tok.empty() || !all_of(tok.begin(),tok.end(),[](char c){return isdigit((unsigned char)c);})) return false; v[i++]=stoi(tok); }
+    return i==kLaneCount;
+}
+
+// --workers / --queue / --deadline-ms followed by a read,write,bulk triple.
+static bool parseLaneOption(ServerOptions& opt, const string& flag, const char* value){
+    int v[kLaneCount];
+    if (flag!="--workers" && flag!="--queue" && flag!="--deadline-ms"){ cerr<<"Unknown option "<<flag<<"\n"; return false; }
+    if (!value || !parseLaneTriple(value,v)){ cerr<<"Bad value for "<<flag<<" (expected read,write,bulk).\n"; return false; }
+    for (int l=0;l<kLaneCount;l++){
+        if (flag=="--workers") opt.lanes[l].workers=max(v[l],1);
+        else if (flag=="--queue") opt.lanes[l].queueCap=(size_t)v[l];
+        else opt.lanes[l].deadlineMs=v[l];
+    }
+    return true;
+}
+
+// EVENT_SMTP_RELAY=host[:port] enables real delivery (EVENT_MAIL_FROM sets
+// the sender, EVENT_SMTP_ROUTES="domain=host:port,..." sends some domains
+// elsewhere); otherwise reminders go through the simulated transport.
+// Sends are journaled to EVENT_OUTBOX (default <spill dir>/reminders.outbox)
+// and resumed from it on start. A journal that doesn't exist yet is created
+// by the first reminder, not at start; EVENT_RETRY_BASE_MS sets the first
+// backoff.
+// EVENT_RATE_LIMITS="global=200,*=20,example.com=5/50" caps recipients per
+// second (optional /burst) overall, per domain, and for listed domains.
+// Start-up notices go to `notes` (stderr in server mode).
+static unique_ptr<ReminderPipeline> makeReminderPipeline(const string& spillDir, ostream& notes = cout){
+    unique_ptr<MailTransport> t;
+#ifndef _WIN32
+    auto parseRoute=[](string hp){ SmtpTransport::Route r{hp,25}; size_t colon=hp.rfind(':');
+        if (colon!=string::npos){ try { r.port=stoi(hp.substr(colon+1)); } catch (...) {} r.host=hp.substr(0,colon); } return r; };
+    if (const char* relay = getenv("EVENT_SMTP_RELAY")){
+        map<string,SmtpTransport::Route> routes;
+        if (const char* spec = getenv("EVENT_SMTP_ROUTES")){
+            stringstream ss(spec); string item;
+            while (getline(ss,item,',')){ size_t eq=item.find('='); if (eq!=string::npos) routes[toLower(item.substr(0,eq))]=parseRoute(item.substr(eq+1)); }
+        }
+        const char* from = getenv("EVENT_MAIL_FROM");
+        t = make_unique<SmtpTransport>(parseRoute(relay),from ? from : "reminders@localhost",routes);
+    }
+#endif
+    if (!t) t = make_unique<SimulatedTransport>();
+    long retryMs = 30000;
+    if (const char* r = getenv("EVENT_RETRY_BASE_MS")){ try { retryMs=max(1L,stol(r)); } catch (...) {} }
+    auto pipeline = make_unique<ReminderPipeline>(move(t),8,500,chrono::milliseconds(retryMs));
+    if (const char* spec = getenv("EVENT_RATE_LIMITS")){
+        stringstream ss(spec); string item;
+        while (getline(ss,item,',')){
+            size_t eq=item.find('='), slash=item.find('/',eq);
+            if (eq==string::npos) continue;
+            try {
+                double rate=stod(item.substr(eq+1)), burst = slash==string::npos ? 0 : stod(item.substr(slash+1));
+                pipeline->setRateLimit(item.substr(0,eq),rate,burst);
+            } catch (...) { notes<<"Ignoring rate limit '"<<item<<"'.\n"; }
+        }
+    }
+    const char* file = getenv("EVENT_OUTBOX");
+    string path = file ? file : spillDir+"/reminders.outbox";
+    if (!ifstream(path)){ pipeline->attachOutboxLazily(path); return pipeline; }
+    int resumed = pipeline->attachOutbox(path,EventManager::reviveRender);
+    if (resumed<0) notes<<"Warning: reminder outbox "<<path<<" is not writable; sends are not journaled.\n";
+    else if (resumed>0) notes<<"Resumed "<<resumed<<" unfinished reminder send(s) from "<<path<<".\n";
+    return pipeline;
+}
+
+// --cluster N: the router (see Cluster) with N workers to start with.
+static int clusterMain(int argc, char** argv){
+    int n=0;
+    if (argc==3 && strlen(argv[2])<=2 && all_of(argv[2],argv[2]+strlen(argv[2]),[](char c){ return isdigit((unsigned char)c); })) n=atoi(argv[2]);
+    if (n<1 || n>64){ cerr<<"usage: --cluster N (1-64 worker processes) < requests\n"; return 2; }
+    Cluster cluster(argv[0]); size_t groups;
+    for (int i=0;i<n;i++) if (cluster.addWorker(groups)<0){ cerr<<"Cannot start cluster worker processes.\n"; return 1; }
+    cin.tie(nullptr);
+    return cluster.run(cin,cout);
+}
+
+static int serverMain(TenantHost& host, int argc, char** argv){
+    ServerOptions opt; int metricsPort=-1;
+    const char* usage="usage: --serve [--metrics-port N] [--workers|--queue|--deadline-ms r,w,b]\n";
+    for (int i=2;i<argc;i++){
+        string flag=argv[i];
+        if (flag=="--metrics-port"){
+            try { metricsPort = i+1<argc ? stoi(argv[++i]) : -2; } catch (...) { metricsPort=-2; }
+            if (metricsPort<0 || metricsPort>65535){ cerr<<"--metrics-port takes 0-65535.\n"<<usage; return 2; }
+        }
+        else if (!parseLaneOption(opt,flag,i+1<argc ? argv[++i] : nullptr)){ cerr<<usage; return 2; }
+    }
+    // Responses flush under outMu; an untied cin keeps request reads from
+    // flushing cout behind that lock while a worker is writing.
+    cin.tie(nullptr);
+    // stdout carries responses, so pipeline notices go to stderr.
+    unique_ptr<ReminderPipeline> reminders = makeReminderPipeline(host.directory(),cerr);
+    Server server(host,opt);
+    server.startReminders(*reminders);
+#ifndef _WIN32
+    MetricsEndpoint endpoint([&server]{ return server.metrics(); });
+    if (metricsPort>=0){
+        string err; int port=endpoint.start(metricsPort,err);
+        if (port<0){ cerr<<"Cannot listen on 127.0.0.1:"<<metricsPort<<": "<<err<<"\n"; return 1; }
+        cerr<<"Metrics on http://127.0.0.1:"<<port<<"/metrics\n";
+    }
+#else
+    if (metricsPort>=0) cerr<<"--metrics-port is not supported on this platform; use METRICS.\n";
+#endif
+    int rc=server.run(cin);
+    server.stopReminders();
+    return host.spillAll() ? rc : 1;
+}
+
+static int replayMain(TenantHost& host, int argc, char** argv){
+    if (argc<3){ cerr<<"usage: --replay FILE [--fast] [--threads N] [--workers|--queue|--deadline-ms r,w,b]\n"; return 2; }
+    string path=argv[2]; bool fast=false; int threads=1; ServerOptions opt;
+    for (int i=3;i<argc;i++){
+        string flag=argv[i];
+        if (flag=="--fast") fast=true;
+        else if (flag=="--threads"){
+            try { threads = i+1<argc ? stoi(argv[++i]) : 0; } catch (...) { threads=0; }
+            if (threads<1 || threads>256){ cerr<<"--threads takes 1-256.\n"; return 2; }
+        }
+        else if (!parseLaneOption(opt,flag,i+1<argc ? argv[++i] : nullptr)) return 2;
+    }
+    vector<ReplayEntry> entries; string err;
+    if (!loadReplay(path,entries,err)){ cerr<<err<<"\n"; return 1; }
+
+    ostream discard(nullptr);
+    Server server(host,opt,discard);
+    // Seqs run 1..entries.size(). A --fast client that finds its answer not
+    // yet in parks on its own condition variable, named in waiter[seq].
+    mutex doneMu; vector<condition_variable> doneCv(threads);
+    vector<char> done(entries.size()+1,0); vector<int> waiter(entries.size()+1,-1);
+    if (fast) server.onAnswer=[&](uint64_t id){
+        lock_guard<mutex> lk(doneMu); done[id]=1;
+        if (waiter[id]>=0) doneCv[waiter[id]].notify_one();
+    };
+    using Clock = chrono::steady_clock;
+    atomic<long long> slipUs{0}, worstSlipUs{0};
+    auto start=Clock::now();
+    vector<thread> clients; vector<Server::Client> sessions(threads);
+    for (int t=0;t<threads;t++) clients.emplace_back([&,t]{
+        for (size_t i=t;i<entries.size();i+=threads){
+            const ReplayEntry& e=entries[i];
+            if (!fast){
+                auto due=start+chrono::milliseconds(e.ms-entries[0].ms);
+                this_thread::sleep_until(due);
+                long long late=chrono::duration_cast<chrono::microseconds>(Clock::now()-due).count();
+                slipUs+=late;
+                for (long long w=worstSlipUs; late>w && !worstSlipUs.compare_exchange_weak(w,late); ) {}
+            }
+            uint64_t id=server.handle(e.line,e.payload,sessions[t]);
+            if (fast){ unique_lock<mutex> lk(doneMu); waiter[id]=t; doneCv[t].wait(lk,[&]{ return done[id]!=0; }); }
+        }
+    });
+    for (auto& c: clients) c.join();
+    server.drain();
+    double secs=chrono::duration<double>(Clock::now()-start).count();
+
+    char rate[32]; snprintf(rate,sizeof rate,"%.0f",entries.size()/secs);
+    cout<<"Replayed "<<entries.size()<<" requests from "<<path<<" in "<<fixed<<setprecision(2)<<secs<<" s ("<<rate<<" req/s), "
+        <<threads<<(threads==1?" client, ":" clients, ")<<(fast?"closed loop":"original pace")<<"\n";
+    cout.unsetf(ios::floatfield);
+    server.tally(cout);
+    if (!fast) cout<<"Schedule slip: mean "<<fmtNanos(1000.0*slipUs/entries.size())<<", max "<<fmtNanos(1000.0*worstSlipUs)<<"\n";
+    cout<<"\n"; opLatency.report(cout,OutputFormat::Table);
+    return 0;
+}
+
+void configureAutoReminders(TenantHost& host, const EventManager& mgr){
+    cout<<"Current offsets (minutes before start):"; for (int m: host.reminderOffsets(currentOrg)) cout<<" "<<m; if (host.reminderOffsets(currentOrg).empty()) cout<<" (off)";
+    cout<<"\nPending automatic reminders: "<<mgr.pendingReminders()<<"\n";
+    if (mgr.unsentReminders()) cout<<"Not sent (no attendees loaded, or the event had started): "<<mgr.unsentReminders()<<"\n";
+    if (!mgr.attendeeCount()) cout<<"No attendees loaded (option 9): automatic reminders fire without being sent.\n";
+    string in; cout<<"New offsets, comma separated (blank = keep, 'off' = disable): "; getline(cin,in);
+    if (in.empty()) return;
+    vector<int> offs;
+    if (in!="off"){
+        stringstream ss(in); string tok;
+        while (getline(ss,tok,',')){
+            tok.erase(remove_if(tok.begin(),tok.end(),[](char c){return isspace((unsigned char)c);}),tok.end());
+            if (tok.empty() || tok.size()>6 || !all_of(tok.begin(),tok.end(),[](char c){return isdigit((unsigned char)c);})){ cout<<"Invalid offsets.\n"; return; }
+            offs.push_back(stoi(tok));
+        }
+    }
+    host.setReminderOffsets(currentOrg,offs);
+    cout<<"Pending automatic reminders: "<<mgr.pendingReminders()<<"\n";
+}
+
+void editTemplate(EventManager& mgr){
+    string which; cout<<"Template: 1) per-date reminder  2) digest: "; getline(cin,which);
+    if (which!="1" && which!="2"){ cout<<"Invalid choice.\n"; return; }
+    ReminderTemplate& t = mgr.messageTemplate(which=="2");
+    cout<<"Placeholders: {{date}} {{recipient}} {{email}} {{unsubscribe}}, and inside {{#events}}...{{/events}}:\n"
+          "  {{name}} {{time}} {{type}} {{location}} {{event_date}}\n";
+    cout<<"Current subject: "<<t.subject.source()<<"\nCurrent body:\n"<<t.body.source()<<"\n";
+    string subject; cout<<"New subject (blank = keep): "; getline(cin,subject); if (subject.empty()) subject=t.subject.source();
+    cout<<"New body, end with a line containing only '.' (a lone '.' first keeps the current body):\n";
+    string body, line; bool first=true;
+    while (getline(cin,line) && line!="."){ body += (first?"":"\n") + line; first=false; }
+    if (first) body=t.body.source(); else body+="\n";
+    string url; cout<<"Unsubscribe base URL ["<<t.unsubscribeBase<<"]: "; getline(cin,url);
+    string err;
+    if (!mgr.setMessageTemplate(which=="2",subject,body,err)){ cout<<"Template not changed: "<<err<<"\n"; return; }
+    if (!url.empty()) mgr.messageTemplate(which=="2").unsubscribeBase=url;
+    cout<<"Template updated"<<(mgr.messageTemplate(which=="2").personalized()?" (personalized: rendered per recipient).":".")<<"\n";
+}
+
+int main(int argc, char** argv){
+    // Only iostreams are used; unsynced cin reads pasted lists in bulk.
+    ios::sync_with_stdio(false);
+    // 64 MiB per organization, 1 GiB resident across all of them.
+    if (argc>1 && string(argv[1])=="--bench") return benchMain(argc,argv);
+    if (argc>1 && string(argv[1])=="--generate") return generateMain(argc,argv);
+    if (argc>1 && string(argv[1])=="--follow") return followerMain(argc,argv);
+    if (argc>1 && string(argv[1])=="--cluster") return clusterMain(argc,argv);
+    const char* spill = getenv("EVENT_SPILL_DIR");
+    TenantHost host(64u<<20, 1024u<<20, spill ? spill : ".");
+    if (argc>1 && string(argv[1])=="--replay") return replayMain(host,argc,argv);
+    if (const char* log = getenv("EVENT_OPLOG")){ if (!opLog.open(log)) cerr<<"Cannot open operation log "<<log<<"\n"; }
+    if (argc>1 && string(argv[1])=="--serve") return serverMain(host,argc,argv);
+    Follower standby("standby");      // tails every change (lag 0 after each command)
+    Follower replica("replica",64);   // serves viewer reads, at most 64 ops stale
+    if (!standby.start(argv[0]) || !replica.start(argv[0])) cout<<"Warning: cannot start follower processes; viewers read the leader.\n";
+    unique_ptr<ReminderPipeline> reminders = makeReminderPipeline(spill ? spill : ".");
+
+    // Background ticker fires automatic reminders while the prompt waits for
+    // input; cliMu serializes it with command handling.
+    mutex cliMu; condition_variable tickCv; bool quit=false;
+    thread ticker([&]{
+        unique_lock<mutex> lk(cliMu);
+        while (!quit){ host.tick(EventManager::nowMinute(),*reminders); tickCv.wait_for(lk,chrono::seconds(15)); }
+    });
 
     cout<<"Login as admin? (y/N): "; string ans; getline(cin,ans); if (!ans.empty() && (ans=="y"||ans=="Y")) adminLogin();
 
+    // CLI actions go to the operation log as the server request they match.
+    auto record=[](const string& request, bool formatted){
+        if (!opLog.enabled()) return;
+        string line = formatted && outputFormat!=OutputFormat::Table ? "format="+string(formatName(outputFormat))+" "+request : request;
+        opLog.record(currentOrg=="default" ? line : "org="+currentOrg+" "+line);
+    };
+
     while (true){
+        {
+            lock_guard<mutex> lk(cliMu);
+            host.account(currentOrg);
+            standby.catchUp(host.acquire(currentOrg),currentOrg);
+        }
         menu(); string choice; getline(cin,choice); if (choice=="0"||cin.eof()) break;
+        lock_guard<mutex> lk(cliMu);
+        EventManager& mgr = host.acquire(currentOrg);
+        // Viewers read from the replica process; admins, or any CLI whose
+        // replica is down, read the leader.
+        auto view=[&](const string& request){
+            string line = outputFormat!=OutputFormat::Table ? "format="+string(formatName(outputFormat))+" "+request : request, body;
+            if (!isAdmin && replica.query(mgr,currentOrg,line,body)){ cout<<body; return; }
+            size_t sp=request.find(' ');
+            runViewerRead(mgr,request.substr(0,sp),sp==string::npos ? "" : request.substr(sp+1),outputFormat);
+        };
         if (choice=="1"){
-            mgr.listAll();
+            record("LIST",true);
+            view("LIST");
         } else if (choice=="2"){
             string d; cout<<"Enter date (DD-MM-YYYY): "; getline(cin,d);
             if (!EventManager::isValidDate(d)){ cout<<"Invalid date.\n"; continue; }
-            mgr.dayView(d);
+            record("DAY "+d,true);
+            view("DAY "+d);
         } else if (choice=="3"){
-            mgr.todaysEvents();
+            record("TODAY",true);
+            view("TODAY");
         } else if (choice=="4"){
-            string k; cout<<"Keyword (name/type): "; getline(cin,k); mgr.search(k);
+            string k; cout<<"Keyword (name/type): "; getline(cin,k);
+            record("SEARCH "+k,true);
+            view("SEARCH "+k);
         } else if (isAdmin && choice=="5"){
             string name,date,time,type,loc; cout<<"Name: "; getline(cin,name);
             cout<<"Date (DD-MM-YYYY): "; getline(cin,date);
             cout<<"Time (HH:MM 24h): "; getline(cin,time);
             cout<<"Type: "; getline(cin,type);
             cout<<"Location (optional): "; getline(cin,loc);
+            record("ADD "+escapeRowField(name)+"|"+escapeRowField(date)+"|"+escapeRowField(time)+"|"+escapeRowField(type)+"|"+escapeRowField(loc),false);
             mgr.addEvent(name,date,time,type,loc);
         } else if (isAdmin && choice=="6"){
             string s; cout<<"ID to edit: "; getline(cin,s);
@@ -359,26 +4834,94 @@ int main(){
         } else if (isAdmin && choice=="7"){
             string s; cout<<"ID to delete: "; getline(cin,s);
             if (s.empty() || any_of(s.begin(),s.end(),[](char c){return !isdigit((unsigned char)c);})){ cout<<"Invalid ID.\n"; continue; }
+            record("DEL "+s,false);
             mgr.deleteById(stoi(s));
         } else if (isAdmin && choice=="8"){
-            string n; cout<<"Name to delete: "; getline(cin,n); mgr.deleteByName(n);
+            string n; cout<<"Name to delete: "; getline(cin,n);
+            record("DELNAME "+n,false);
+            mgr.deleteByName(n);
         } else if (isAdmin && choice=="9"){
-            mgr.loadAttendeesFromPaste();
+            mgr.loadAttendeesFromPaste(); standby.resync();
         } else if (isAdmin && choice=="10"){
             string d; cout<<"Send reminders for date (DD-MM-YYYY): "; getline(cin,d);
             if (!EventManager::isValidDate(d)){ cout<<"Invalid date.\n"; continue; }
-            mgr.sendReminderForDate(d);
+            mgr.sendReminderForDate(d,*reminders);
         } else if (isAdmin && choice=="11"){
-            mgr.statistics();
+            record("STATS",true);
+            mgr.statistics(outputFormat);
         } else if (isAdmin && choice=="12"){
-            mgr.exportSnapshotCSV();
+            record("EXPORT",true);
+            mgr.exportSnapshotCSV(outputFormat);
         } else if (isAdmin && choice=="13"){
             mgr.importSnapshotCSV();
+        } else if (isAdmin && choice=="14"){
+            standby.catchUp(mgr,currentOrg); replicationStatus(mgr,standby,replica);
+        } else if (isAdmin && choice=="15"){
+            watchScope(mgr);
+        } else if (isAdmin && choice=="16"){
+            string s; cout<<"Watch ID to stop: "; getline(cin,s);
+            if (s.empty() || any_of(s.begin(),s.end(),[](char c){return !isdigit((unsigned char)c);})){ cout<<"Invalid ID.\n"; continue; }
+            cout<<(mgr.unsubscribe(stoi(s))?"Stopped.\n":"No such watch.\n");
+        } else if (choice=="17"){
+            string org; cout<<"Organization: "; getline(cin,org);
+            if (org.empty()){ cout<<"Invalid organization.\n"; continue; }
+            currentOrg=org; isAdmin=adminOrgs.count(org)>0;
+            cout<<"Switched to '"<<org<<"'"<<(isAdmin?" (admin)":"")<<".\n";
+        } else if (isAdmin && choice=="18"){
+            record("MEMORY",true);
+            host.account(currentOrg); host.report(cout);
+            vector<MemoryPart> parts=host.memoryBreakdown();
+            parts.push_back({"latency histograms",opLatency.memoryBytes()});
+            if (size_t t=traceBytes()) parts.push_back({"trace rings",t});
+            cout<<"\n"; writeMemoryReport(cout,parts,outputFormat);
+        } else if (isAdmin && choice=="19"){
+            reminders->report(cout);
+        } else if (isAdmin && choice=="20"){
+            configureAutoReminders(host,mgr);
+        } else if (isAdmin && choice=="21"){
+            string s; cout<<"Event ID: "; getline(cin,s);
+            if (s.empty() || any_of(s.begin(),s.end(),[](char c){return !isdigit((unsigned char)c);})){ cout<<"Invalid ID.\n"; continue; }
+            mgr.registerAttendeesFromPaste(stoi(s)); standby.resync();
+        } else if (isAdmin && choice=="22"){
+            string from,to; cout<<"From date (DD-MM-YYYY): "; getline(cin,from);
+            cout<<"To date (blank = same day): "; getline(cin,to); if (to.empty()) to=from;
+            if (!EventManager::isValidDate(from) || !EventManager::isValidDate(to) || EventManager::dayKey(to)<EventManager::dayKey(from)){ cout<<"Invalid date range.\n"; continue; }
+            mgr.sendDigestForRange(from,to,*reminders);
+        } else if (isAdmin && choice=="23"){
+            editTemplate(mgr); standby.resync();
+        } else if (isAdmin && choice=="27"){
+            record("LATENCY",true);
+            opLatency.report(cout,outputFormat);
+        } else if (isAdmin && choice=="28"){
+            string path; cout<<"Chrome trace file (default trace.json): "; getline(cin,path); if (path.empty()) path="trace.json";
+            ofstream os(path); ostringstream probe;
+            if (!traceDump(probe)){ cout<<"Tracing is compiled out (build with -DEVENT_TRACING).\n"; continue; }
+            if (!(os<<probe.str())){ cout<<"Cannot write "<<path<<".\n"; continue; }
+            cout<<"Wrote "<<path<<" (open in chrome://tracing or Perfetto).\n";
+        } else if (choice=="24"){
+            string f; cout<<"Format (table/csv/tsv/json): "; getline(cin,f);
+            if (!parseOutputFormat(f,outputFormat)){ cout<<"Unknown format.\n"; continue; }
+            cout<<"Listings now print as "<<formatName(outputFormat)<<".\n";
+        } else if (choice=="25"){
+            string d; cout<<"Any date in the week (DD-MM-YYYY): "; getline(cin,d);
+            if (!EventManager::isValidDate(d)){ cout<<"Invalid date.\n"; continue; }
+            record("WEEK "+d,true);
+            view("WEEK "+d);
+        } else if (choice=="26"){
+            string s; int m,y; cout<<"Month (MM-YYYY): "; getline(cin,s);
+            if (!EventManager::parseMonth(s,m,y)){ cout<<"Invalid month.\n"; continue; }
+            record("MONTH "+s,true);
+            view("MONTH "+s);
         } else {
-            cout<<"Invalid choice."<<(isAdmin?" Try 0-13.":" Try 0-4.")<<"\n";
+            cout<<"Invalid choice."<<(isAdmin?" Try 0-28.":" Try 0-4, 17 or 24-26.")<<"\n";
         }
     }
 
+    { lock_guard<mutex> lk(cliMu); quit=true; }
+    tickCv.notify_all(); ticker.join();
+    host.spillAll();
+    standby.stop(); replica.stop();
+
     cout<<"Goodbye!\n";
     return 0;
 }
\ No newline at end of file